@@ -0,0 +1,14 @@
+#version 330
+
+in vec4 shade;
+in vec2 uv;
+
+uniform bool textured;
+uniform sampler2D tex;
+
+out vec4 fragColor;
+
+// textures modulate the shading, like GL_MODULATE
+void main() {
+	fragColor = textured ? shade * texture(tex, uv) : shade;
+}
@@ -0,0 +1,51 @@
+#version 330
+
+// one vertex of a mesh, and the model matrix of the instance it belongs to, which takes locations 3 to 6
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 texCoord;
+layout(location = 3) in mat4 model;
+
+// laid out like ShaderMaterial in shader.c
+struct MaterialData {
+	vec4 ambient, diffuse, specular;
+	float shininess;
+};
+
+layout(std140) uniform Materials {
+	MaterialData materials[128];
+};
+
+uniform mat4 view, projection;
+uniform vec3 lightDir;
+uniform int material;
+uniform vec4 color;
+uniform bool lighting;
+uniform vec4 atlasRect;
+
+out vec4 shade;
+out vec2 uv;
+
+// lit per vertex the same way the fixed function pipeline lights GL_LIGHT0 as a white directional light,
+// with the default global ambient of 0.2 and no local viewer
+void main() {
+	mat4 modelView = view * model;
+	vec4 eyePos = modelView * vec4(position, 1.0);
+	gl_Position = projection * eyePos;
+	uv = atlasRect.xy + texCoord * atlasRect.zw;
+
+	if (!lighting) {
+		shade = color;
+		return;
+	}
+
+	MaterialData m = materials[material];
+	vec3 n = normalize(transpose(inverse(mat3(modelView))) * normal);
+	float d = dot(n, lightDir);
+	vec3 c = 0.2 * m.ambient.rgb + max(d, 0.0) * m.diffuse.rgb;
+	if (d > 0.0) {
+		vec3 h = normalize(lightDir + vec3(0.0, 0.0, 1.0));
+		c += pow(max(dot(n, h), 0.0), m.shininess) * m.specular.rgb;
+	}
+	shade = vec4(clamp(c, 0.0, 1.0), m.diffuse.a);
+}
@@ -0,0 +1,146 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "archive.h"
+#include "pakfile.h"
+#include "util.h"
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * A loose file that has been mapped because there was no archive, kept so asking again doesn't map it twice
+ */
+typedef struct {
+	char* name;
+	void* data;
+	size_t size;
+} LooseAsset;
+
+static struct {
+	char dir[512];
+	void* data;
+	size_t size;
+	const PakHeader* header;
+	const PakEntry* entries;
+	LooseAsset* loose;
+	size_t numLoose, maxLoose;
+} assets;
+
+static void* mapFile(const char* path, size_t* size) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		return NULL;
+	}
+
+	void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return NULL;
+
+	*size = st.st_size;
+	return data;
+}
+
+static bool openArchive(const char* path) {
+	size_t size;
+	void* data = mapFile(path, &size);
+	if (!data)
+		return false;
+
+	const PakHeader* header = (const PakHeader*) data;
+	if (size < sizeof(PakHeader) || header->magic != PAK_MAGIC
+		|| sizeof(PakHeader) + header->numEntries * sizeof(PakEntry) > size) {
+		printf("%s isn't an asset archive\n", path);
+		munmap(data, size);
+		return false;
+	}
+
+	// the whole archive is going to be needed, so have it read in one go rather than a page fault at a time
+	posix_madvise(data, size, POSIX_MADV_WILLNEED);
+
+	assets.data = data;
+	assets.size = size;
+	assets.header = header;
+	assets.entries = (const PakEntry*) (header + 1);
+	return true;
+}
+
+/*
+ * Open the archive, trying next to the executable first so the game can be run from anywhere
+ */
+bool openAssets(const char* exePath) {
+	const char* slash = exePath ? strrchr(exePath, '/') : NULL;
+	if (slash)
+		snprintf(assets.dir, sizeof(assets.dir), "%.*s/", (int) (slash - exePath), exePath);
+	else
+		assets.dir[0] = '\0';
+
+	char path[1024];
+	snprintf(path, sizeof(path), "%sres.pak", assets.dir);
+	return openArchive(path) || openArchive("res.pak");
+}
+
+void closeAssets() {
+	if (assets.data)
+		munmap(assets.data, assets.size);
+	for (size_t i = 0; i < assets.numLoose; ++i) {
+		munmap(assets.loose[i].data, assets.loose[i].size);
+		free(assets.loose[i].name);
+	}
+	free(assets.loose);
+	memset(&assets, 0, sizeof(assets));
+}
+
+static int compareEntry(const void* key, const void* entry) {
+	return strncmp((const char*) key, ((const PakEntry*) entry)->name, maxPakName);
+}
+
+static const unsigned char* findLooseAsset(const char* name, size_t* size) {
+	for (size_t i = 0; i < assets.numLoose; ++i) {
+		if (strcmp(assets.loose[i].name, name) == 0) {
+			*size = assets.loose[i].size;
+			return (const unsigned char*) assets.loose[i].data;
+		}
+	}
+
+	char path[1024];
+	snprintf(path, sizeof(path), "%s%s", assets.dir, name);
+	void* data = mapFile(name, size);
+	if (!data)
+		data = mapFile(path, size);
+	if (!data)
+		return NULL;
+
+	if (assets.numLoose == assets.maxLoose) {
+		assets.maxLoose = max(assets.maxLoose * 2, 16);
+		assets.loose = (LooseAsset*) realloc(assets.loose, assets.maxLoose * sizeof(LooseAsset));
+	}
+	char* copy = (char*) malloc(strlen(name) + 1);
+	strcpy(copy, name);
+	assets.loose[assets.numLoose++] = (LooseAsset) { copy, data, *size };
+	return (const unsigned char*) data;
+}
+
+/*
+ * Get the bytes of an asset without copying them, or NULL if there is no such asset
+ */
+const unsigned char* findAsset(const char* name, size_t* size) {
+	if (!assets.header)
+		return findLooseAsset(name, size);
+
+	const PakEntry* entry = (const PakEntry*) bsearch(name, assets.entries, assets.header->numEntries,
+		sizeof(PakEntry), compareEntry);
+	if (!entry || (size_t) entry->offset + entry->size > assets.size)
+		return NULL;
+
+	*size = entry->size;
+	return (const unsigned char*) assets.data + entry->offset;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * Access to the game's assets by name, like "res/grass.png". Everything comes out of res.pak when there is one next to
+ * the executable or in the working directory, mapped once so assets are just ranges of it. Without the archive, each
+ * asset is mapped from the loose file instead, looked for in the working directory and then next to the executable.
+ * Asset memory stays valid until closeAssets
+ */
+bool openAssets(const char* exePath);
+void closeAssets();
+
+const unsigned char* findAsset(const char* name, size_t* size);
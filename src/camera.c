@@ -1,5 +1,6 @@
 #include "camera.h"
 #include "gl.h"
+#include "util.h"
 
 /*
  * Initialise the parameters of our camera
@@ -14,22 +15,78 @@ void initCamera(Camera* camera) {
 }
 
 /*
- * Apply our view transformation based on the camera's zoom, rotation and position
+ * Pull the frustum planes out of the combined projection and view matrix (Gribb and Hartmann)
+ */
+static void updateFrustum(Camera* camera) {
+	Mat4f m = mulMat4f(camera->projection, camera->view);
+	const float* a = m.m;
+
+	for (int i = 0; i < 3; ++i) {
+		// rows are strided by 4 in column-major order, the planes are row 3 plus and minus row i
+		Vec4f* lo = &camera->frustum.planes[i * 2];
+		Vec4f* hi = &camera->frustum.planes[i * 2 + 1];
+		*lo = (Vec4f) { a[3] + a[i], a[7] + a[4 + i], a[11] + a[8 + i], a[15] + a[12 + i] };
+		*hi = (Vec4f) { a[3] - a[i], a[7] - a[4 + i], a[11] - a[8 + i], a[15] - a[12 + i] };
+	}
+
+	for (int i = 0; i < 6; ++i) {
+		Vec4f* p = &camera->frustum.planes[i];
+		float mag = magVec3f((Vec3f) { p->x, p->y, p->z });
+		p->x /= mag;
+		p->y /= mag;
+		p->z /= mag;
+		p->w /= mag;
+	}
+}
+
+/*
+ * Apply our view transformation based on the camera's zoom, rotation and position.
+ * This also starts counting the culled and drawn objects again for the new frame
  */
 void applyViewMatrix(Camera* camera) {
-	glLoadIdentity();
-	glTranslatef(0, 0, -camera->zoom);
-	glRotatef(camera->yRot, 1, 0, 0);
-	glRotatef(camera->xRot, 0, 1, 0);
-	glTranslatef(-camera->pos.x, -camera->pos.y, -camera->pos.z);
+	Mat4f view = identityMat4f();
+	view = translateMat4f(view, 0, 0, -camera->zoom);
+	view = rotateMat4f(view, camera->yRot, 1, 0, 0);
+	view = rotateMat4f(view, camera->xRot, 0, 1, 0);
+	view = translateMat4f(view, -camera->pos.x, -camera->pos.y, -camera->pos.z);
+	camera->view = view;
+
+	// the view is a rotation and a translation, so the eye is the translation taken back through the transposed rotation
+	const float* a = view.m;
+	camera->eye.x = -(a[0] * a[12] + a[1] * a[13] + a[2] * a[14]);
+	camera->eye.y = -(a[4] * a[12] + a[5] * a[13] + a[6] * a[14]);
+	camera->eye.z = -(a[8] * a[12] + a[9] * a[13] + a[10] * a[14]);
+
+	glLoadMatrixf(camera->view.m);
+
+	updateFrustum(camera);
+	camera->numDrawn = 0;
+	camera->numCulled = 0;
 }
 
 /*
  * Create a projection matrix based on the camera's fov, dimensions and near and far planes
  */
 void applyProjectionMatrix(Camera* camera) {
+	camera->projection = perspectiveMat4f(camera->fovY, (float)camera->width / (float)camera->height, camera->near, camera->far);
+	camera->pixelsPerUnit = camera->height / (2.0 * tanf(camera->fovY * M_PI / 360.0));
+
 	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity();
-	gluPerspective(camera->fovY, (float)camera->width / (float)camera->height, camera->near, camera->far);
+	glLoadMatrixf(camera->projection.m);
 	glMatrixMode(GL_MODELVIEW);
 }
+
+/*
+ * Check a world space bounding sphere against the view frustum, and count it as drawn or culled
+ */
+bool isSphereVisible(Camera* camera, Vec3f center, float radius) {
+	for (int i = 0; i < 6; ++i) {
+		Vec4f p = camera->frustum.planes[i];
+		if (p.x * center.x + p.y * center.y + p.z * center.z + p.w < -radius) {
+			camera->numCulled++;
+			return false;
+		}
+	}
+	camera->numDrawn++;
+	return true;
+}
@@ -1,15 +1,37 @@
 #pragma once
 
 #include "vec.h"
+#include "mat.h"
 
+#include <stdbool.h>
+
+/*
+ * The six planes of the view frustum, as (a, b, c, d) with the normals pointing inwards
+ */
+typedef struct {
+	Vec4f planes[6];
+} Frustum;
+
+/*
+ * The view and projection matrices are kept on the CPU as well so the frustum can be worked out from them.
+ * eye is the world space position of the camera, and pixelsPerUnit is how many pixels across
+ * something one unit wide is when it is one unit in front of the camera.
+ * numDrawn and numCulled count the visibility tests since the view was last applied
+ */
 typedef struct {
 	float xRot, yRot, zoom;
 	Vec3f pos;
 	int lastX, lastY;
 	int width, height;
 	float fovY, near, far;
+	Mat4f view, projection;
+	Vec3f eye;
+	float pixelsPerUnit;
+	Frustum frustum;
+	int numDrawn, numCulled;
 } Camera;
 
 void initCamera(Camera* camera);
 void applyViewMatrix(Camera* camera);
 void applyProjectionMatrix(Camera* camera);
+bool isSphereVisible(Camera* camera, Vec3f center, float radius);
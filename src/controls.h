@@ -1,5 +1,10 @@
 #pragma once
 
+/*
+ * The player's controls, as they are named in control input events
+ */
+enum { upControl, downControl, leftControl, rightControl, turnLeftControl, turnRightControl, jumpControl, n_controls };
+
 /*
  * All of the controls needed by the player
  */
@@ -9,4 +14,3 @@ typedef struct {
 	bool jump;
 	bool lmb, rmb;
 } Controls;
-
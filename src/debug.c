@@ -0,0 +1,151 @@
+#include "debug.h"
+#include "gl.h"
+#include "stream.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/*
+ * All of the lines added this frame, along with the transform that is applied to new ones
+ */
+static struct {
+	DebugVertex* verts;
+	size_t numVerts, maxVerts;
+	Mat4f transform;
+} debugLines;
+
+/*
+ * Use the current modelview matrix, multiplied by local if it isn't NULL, for the lines added after this
+ */
+void setDebugTransform(const Mat4f* local) {
+	glGetFloatv(GL_MODELVIEW_MATRIX, debugLines.transform.m);
+	if (local)
+		debugLines.transform = mulMat4f(debugLines.transform, *local);
+}
+
+static DebugVertex* reserveDebugVerts(size_t numVerts) {
+	if (debugLines.numVerts + numVerts > debugLines.maxVerts) {
+		debugLines.maxVerts = max(debugLines.maxVerts * 2, debugLines.numVerts + numVerts);
+		debugLines.verts = (DebugVertex*) realloc(debugLines.verts, debugLines.maxVerts * sizeof(DebugVertex));
+	}
+	DebugVertex* v = debugLines.verts + debugLines.numVerts;
+	debugLines.numVerts += numVerts;
+	return v;
+}
+
+/*
+ * Add a line from a to b
+ */
+void drawLine(Vec3f color, Vec3f a, Vec3f b) {
+	DebugVertex* v = reserveDebugVerts(2);
+	v[0] = (DebugVertex) { transformPointMat4f(debugLines.transform, a), color };
+	v[1] = (DebugVertex) { transformPointMat4f(debugLines.transform, b), color };
+}
+
+/*
+ * Add a list of lines, every two vertices make up a line
+ */
+void drawLines(const DebugVertex* verts, size_t numVerts) {
+	DebugVertex* v = reserveDebugVerts(numVerts);
+	for (size_t i = 0; i < numVerts; ++i) {
+		v[i].pos = transformPointMat4f(debugLines.transform, verts[i].pos);
+		v[i].color = verts[i].color;
+	}
+}
+
+/*
+ * Add a set of coloured axes at the origin
+ */
+void drawAxes() {
+	Vec3f origin = { 0, 0, 0 };
+	drawLine(RED, origin, (Vec3f) { 1, 0, 0 });
+	drawLine(GREEN, origin, (Vec3f) { 0, 1, 0 });
+	drawLine(BLUE, origin, (Vec3f) { 0, 0, 1 });
+}
+
+/*
+ * Add a parabola for the specified initial velocity and gravity.
+ * The line segments are kept in the cache and only worked out again when the velocity, gravity or flags change
+ */
+void drawParabola(LineCache* cache, Vec3f color, Vec3f vel, float g, DrawingFlags* flags) {
+	if (!cache->verts || cache->g != g || cache->segments != flags->segments || cache->normals != flags->normals ||
+			memcmp(&cache->vel, &vel, sizeof(Vec3f)) != 0 || memcmp(&cache->color, &color, sizeof(Vec3f)) != 0) {
+		float tof = (2.0 * vel.y) / g;
+		float step = tof / (float) flags->segments;
+
+		cache->verts = (DebugVertex*) realloc(cache->verts, flags->segments * 4 * sizeof(DebugVertex));
+		cache->numVerts = 0;
+
+		// this loop doesn't draw the last tangent, but usually it won't be visible through the floor so it's not a huge deal
+		for (size_t i = 0; i < flags->segments; ++i) {
+			float t0 = i * step;
+			float t1 = (i + 1) * step;
+
+			Vec3f a = { t0 * vel.x, t0 * vel.y - 0.5 * g * t0 * t0, t0 * vel.z };
+			Vec3f b = { t1 * vel.x, t1 * vel.y - 0.5 * g * t1 * t1, t1 * vel.z };
+
+			cache->verts[cache->numVerts++] = (DebugVertex) { a, color };
+			cache->verts[cache->numVerts++] = (DebugVertex) { b, color };
+
+			if (flags->normals) {
+				Vec3f t = { vel.x, vel.y - g * t0, vel.z };
+				t = mulVec3f(normaliseVec3f(t), 0.05);
+				t = addVec3f(a, t);
+				cache->verts[cache->numVerts++] = (DebugVertex) { a, CYAN };
+				cache->verts[cache->numVerts++] = (DebugVertex) { t, CYAN };
+			}
+		}
+
+		cache->color = color;
+		cache->vel = vel;
+		cache->g = g;
+		cache->segments = flags->segments;
+		cache->normals = flags->normals;
+	}
+
+	drawLines(cache->verts, cache->numVerts);
+}
+
+void destroyLineCache(LineCache* cache) {
+	free(cache->verts);
+	cache->verts = NULL;
+	cache->numVerts = 0;
+}
+
+/*
+ * Draw every line added this frame with a single draw call and empty the buffer for the next one
+ */
+void flushDebugLines() {
+	if (debugLines.numVerts == 0)
+		return;
+
+	glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
+	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+	glDisable(GL_LIGHTING);
+	glDisable(GL_TEXTURE_2D);
+
+	// the lines are already in eye space
+	glPushMatrix();
+	glLoadIdentity();
+
+	size_t size = debugLines.numVerts * sizeof(DebugVertex);
+	StreamRange range = allocStream(size);
+	memcpy(range.data, debugLines.verts, size);
+	commitStream(&range, size);
+	glBindBuffer(GL_ARRAY_BUFFER, range.buffer);
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glVertexPointer(3, GL_FLOAT, sizeof(DebugVertex), (void*) (range.offset + offsetof(DebugVertex, pos)));
+	glColorPointer(3, GL_FLOAT, sizeof(DebugVertex), (void*) (range.offset + offsetof(DebugVertex, color)));
+
+	glDrawArrays(GL_LINES, 0, debugLines.numVerts);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glPopMatrix();
+
+	glPopClientAttrib();
+	glPopAttrib();
+
+	debugLines.numVerts = 0;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "util.h"
+#include "mat.h"
+#include "mesh.h"
+
+/*
+ * Debug lines (normals, axes, the jump parabola and velocities) are collected into one buffer over the frame
+ * and drawn together by flushDebugLines. They are stored in eye space, so each producer has to call
+ * setDebugTransform with its modelview in place before adding lines
+ */
+typedef struct {
+	Vec3f pos, color;
+} DebugVertex;
+
+/*
+ * Line geometry which is kept between frames and only regenerated when the parameters it was built from change
+ */
+typedef struct {
+	Vec3f color, vel;
+	float g;
+	size_t segments;
+	bool normals;
+	DebugVertex* verts;
+	size_t numVerts;
+} LineCache;
+
+void setDebugTransform(const Mat4f* local);
+void drawLine(Vec3f color, Vec3f a, Vec3f b);
+void drawLines(const DebugVertex* verts, size_t numVerts);
+void drawAxes();
+void drawParabola(LineCache* cache, Vec3f color, Vec3f vel, float g, DrawingFlags* flags);
+void destroyLineCache(LineCache* cache);
+void flushDebugLines();
@@ -9,6 +9,8 @@
 #    include <Windows.h>
 #  endif
 // #  include <GL/glew.h>
+// buffer objects and friends are past GL 1.1, so ask for the prototypes instead of loading them by hand
+#  define GL_GLEXT_PROTOTYPES
 #  include <GL/gl.h>
 #  include <GL/glu.h>
 #  include <GL/glut.h>
@@ -0,0 +1,135 @@
+#include "glstate.h"
+#include "gl.h"
+
+#include <string.h>
+
+enum { n_cached_caps = 6, n_cached_targets = 2 };
+
+static const GLenum cachedCaps[n_cached_caps] = {
+	GL_LIGHTING, GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP, GL_BLEND, GL_DEPTH_TEST, GL_ALPHA_TEST
+};
+static const GLenum cachedTargets[n_cached_targets] = { GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP };
+
+/*
+ * What we last told GL, and whether we know it at all
+ */
+static struct {
+	bool capKnown[n_cached_caps];
+	bool caps[n_cached_caps];
+	bool textureKnown[n_cached_targets];
+	unsigned int textures[n_cached_targets];
+	bool polygonModeKnown;
+	GLenum polygonMode;
+	bool depthMaskKnown;
+	bool depthMask;
+	bool programKnown;
+	unsigned int program;
+	bool materialKnown;
+	Material material;
+	GLStateStats stats;
+} state;
+
+/*
+ * Forget everything, so the next change of each piece of state goes through
+ */
+void invalidateGLState() {
+	GLStateStats stats = state.stats;
+	memset(&state, 0, sizeof(state));
+	state.stats = stats;
+}
+
+void setEnabled(unsigned int cap, bool enabled) {
+	for (int i = 0; i < n_cached_caps; ++i) {
+		if (cachedCaps[i] != cap)
+			continue;
+		if (state.capKnown[i] && state.caps[i] == enabled) {
+			state.stats.skipped++;
+			return;
+		}
+		state.capKnown[i] = true;
+		state.caps[i] = enabled;
+		break;
+	}
+
+	// caps the cache doesn't track always go through
+	state.stats.issued++;
+	if (enabled)
+		glEnable(cap);
+	else
+		glDisable(cap);
+}
+
+void bindTexture(unsigned int target, unsigned int texture) {
+	for (int i = 0; i < n_cached_targets; ++i) {
+		if (cachedTargets[i] != target)
+			continue;
+		if (state.textureKnown[i] && state.textures[i] == texture) {
+			state.stats.skipped++;
+			return;
+		}
+		state.textureKnown[i] = true;
+		state.textures[i] = texture;
+		break;
+	}
+
+	state.stats.issued++;
+	glBindTexture(target, texture);
+}
+
+void setPolygonMode(unsigned int mode) {
+	if (state.polygonModeKnown && state.polygonMode == mode) {
+		state.stats.skipped++;
+		return;
+	}
+	state.polygonModeKnown = true;
+	state.polygonMode = mode;
+
+	state.stats.issued++;
+	glPolygonMode(GL_FRONT_AND_BACK, mode);
+}
+
+void setDepthMask(bool write) {
+	if (state.depthMaskKnown && state.depthMask == write) {
+		state.stats.skipped++;
+		return;
+	}
+	state.depthMaskKnown = true;
+	state.depthMask = write;
+
+	state.stats.issued++;
+	glDepthMask(write ? GL_TRUE : GL_FALSE);
+}
+
+void useProgram(unsigned int program) {
+	if (state.programKnown && state.program == program) {
+		state.stats.skipped++;
+		return;
+	}
+	state.programKnown = true;
+	state.program = program;
+
+	state.stats.issued++;
+	glUseProgram(program);
+}
+
+/*
+ * Remember a material as the current one. Returns false if it already was, so there's nothing to apply
+ */
+bool cacheMaterial(const Material* material) {
+	if (state.materialKnown && memcmp(&state.material, material, sizeof(Material)) == 0) {
+		state.stats.skipped++;
+		return false;
+	}
+	state.materialKnown = true;
+	state.material = *material;
+	state.stats.issued++;
+	return true;
+}
+
+GLStateStats getGLStateStats() {
+	return state.stats;
+}
+
+void resetGLStateStats() {
+	state.stats = (GLStateStats) { 0, 0 };
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "material.h"
+
+#include <stdbool.h>
+
+/*
+ * A thin cache in front of the GL state that gets changed for almost every draw: a few enables, the bound textures,
+ * the material, the polygon mode, the depth mask and the shader program. Calls that wouldn't change anything are skipped.
+ * The cache only knows about changes made through it, so code that changes the same state directly has to put it back
+ * (with glPushAttrib/glPopAttrib, say) without calling into the cache in between
+ */
+typedef struct {
+	int issued, skipped;
+} GLStateStats;
+
+void invalidateGLState();
+
+void setEnabled(unsigned int cap, bool enabled);
+void bindTexture(unsigned int target, unsigned int texture);
+void setPolygonMode(unsigned int mode);
+void setDepthMask(bool write);
+void useProgram(unsigned int program);
+bool cacheMaterial(const Material* material);
+
+GLStateStats getGLStateStats();
+void resetGLStateStats();
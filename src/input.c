@@ -0,0 +1,49 @@
+#include "input.h"
+
+void initInputQueue(InputQueue* queue) {
+	atomic_store(&queue->head, 0);
+	atomic_store(&queue->tail, 0);
+	atomic_store(&queue->dropped, 0);
+}
+
+/*
+ * Add an event on the producer's thread. Returns false if the ring is full and the event was dropped
+ */
+bool pushInput(InputQueue* queue, const InputEvent* event) {
+	size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+	size_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+	if (tail - head == inputQueueSize) {
+		atomic_fetch_add_explicit(&queue->dropped, 1, memory_order_relaxed);
+		return false;
+	}
+
+	queue->events[tail % inputQueueSize] = *event;
+	atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+	return true;
+}
+
+/*
+ * The oldest event on the consumer's thread, or NULL if there isn't one. It stays put until popInput
+ */
+const InputEvent* peekInput(InputQueue* queue) {
+	size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+	size_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+	if (head == tail)
+		return NULL;
+	return &queue->events[head % inputQueueSize];
+}
+
+/*
+ * Let go of the event from peekInput, making its slot available to the producer
+ */
+void popInput(InputQueue* queue) {
+	size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+	atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+}
+
+/*
+ * How many events have been dropped because the ring was full
+ */
+unsigned int countDroppedInput(InputQueue* queue) {
+	return atomic_load_explicit(&queue->dropped, memory_order_relaxed);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+/*
+ * A control is one of the player's controls from controls.h, pressed or let go. A halt stops or starts time.
+ * Buttons and motion are the mouse, with the window position it was at
+ */
+enum { controlInput, haltInput, buttonInput, motionInput };
+
+enum { inputQueueSize = 256 };
+
+/*
+ * time is when the event happened, from getClockTime, so the consumer can tell which step it falls in
+ */
+typedef struct {
+	int type;
+	double time;
+	int control;
+	bool down;
+	int x, y;
+} InputEvent;
+
+/*
+ * A bounded ring of events from one producer thread to one consumer thread. The producer only moves tail and the consumer
+ * only moves head, each publishing its slot with a release store, so neither ever locks. If the consumer falls a whole ring
+ * behind, new events are dropped and counted rather than overwriting ones it hasn't seen
+ */
+typedef struct {
+	InputEvent events[inputQueueSize];
+	atomic_size_t head, tail;
+	atomic_uint dropped;
+} InputQueue;
+
+void initInputQueue(InputQueue* queue);
+
+bool pushInput(InputQueue* queue, const InputEvent* event);
+const InputEvent* peekInput(InputQueue* queue);
+void popInput(InputQueue* queue);
+
+unsigned int countDroppedInput(InputQueue* queue);
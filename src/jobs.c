@@ -0,0 +1,154 @@
+#include "jobs.h"
+
+#include <stdlib.h>
+#include <pthread.h>
+
+enum { numWorkers = 4 };
+
+typedef struct Job {
+	JobFunc work, finish;
+	void* data;
+	struct Job* next;
+} Job;
+
+/*
+ * Jobs waiting for a worker and jobs waiting to be finished, both first in first out
+ */
+typedef struct {
+	Job *head, *tail;
+} JobQueue;
+
+static struct {
+	pthread_t workers[numWorkers];
+	bool running, quit;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	JobQueue queued, done;
+	int pending;
+} jobs;
+
+static void pushJob(JobQueue* queue, Job* job) {
+	job->next = NULL;
+	if (queue->tail)
+		queue->tail->next = job;
+	else
+		queue->head = job;
+	queue->tail = job;
+}
+
+static Job* popJob(JobQueue* queue) {
+	Job* job = queue->head;
+	if (job) {
+		queue->head = job->next;
+		if (!queue->head)
+			queue->tail = NULL;
+	}
+	return job;
+}
+
+static void* runWorker(void* arg) {
+	(void) arg;
+
+	pthread_mutex_lock(&jobs.lock);
+	while (true) {
+		Job* job = popJob(&jobs.queued);
+		if (!job) {
+			// only stop once everything queued has run, so every job gets its finish
+			if (jobs.quit)
+				break;
+			pthread_cond_wait(&jobs.wake, &jobs.lock);
+			continue;
+		}
+
+		pthread_mutex_unlock(&jobs.lock);
+		job->work(job->data);
+		pthread_mutex_lock(&jobs.lock);
+
+		pushJob(&jobs.done, job);
+	}
+	pthread_mutex_unlock(&jobs.lock);
+	return NULL;
+}
+
+void initJobs() {
+	if (jobs.running)
+		return;
+
+	pthread_mutex_init(&jobs.lock, NULL);
+	pthread_cond_init(&jobs.wake, NULL);
+	jobs.quit = false;
+	for (int i = 0; i < numWorkers; ++i)
+		pthread_create(&jobs.workers[i], NULL, runWorker, NULL);
+	jobs.running = true;
+}
+
+/*
+ * Wait for the workers to get through what is queued, finish it, and stop the threads
+ */
+void destroyJobs() {
+	if (!jobs.running)
+		return;
+
+	pthread_mutex_lock(&jobs.lock);
+	jobs.quit = true;
+	pthread_cond_broadcast(&jobs.wake);
+	pthread_mutex_unlock(&jobs.lock);
+
+	for (int i = 0; i < numWorkers; ++i)
+		pthread_join(jobs.workers[i], NULL);
+	jobs.running = false;
+
+	finishJobs();
+	pthread_cond_destroy(&jobs.wake);
+	pthread_mutex_destroy(&jobs.lock);
+}
+
+/*
+ * Queue a job for the workers. Without a pool the work is done straight away
+ */
+void submitJob(JobFunc work, JobFunc finish, void* data) {
+	Job* job = (Job*) malloc(sizeof(Job));
+	*job = (Job) { work, finish, data, NULL };
+
+	if (!jobs.running) {
+		work(data);
+		if (finish)
+			finish(data);
+		free(job);
+		return;
+	}
+
+	pthread_mutex_lock(&jobs.lock);
+	pushJob(&jobs.queued, job);
+	jobs.pending++;
+	pthread_cond_signal(&jobs.wake);
+	pthread_mutex_unlock(&jobs.lock);
+}
+
+/*
+ * Run the finish step of every job the workers are done with, on the calling thread
+ */
+void finishJobs() {
+	if (!jobs.pending)
+		return;
+
+	pthread_mutex_lock(&jobs.lock);
+	JobQueue done = jobs.done;
+	jobs.done = (JobQueue) { NULL, NULL };
+	pthread_mutex_unlock(&jobs.lock);
+
+	Job* job;
+	while ((job = popJob(&done))) {
+		if (job->finish)
+			job->finish(job->data);
+		free(job);
+		jobs.pending--;
+	}
+}
+
+/*
+ * Whether anything submitted hasn't been finished yet
+ */
+bool jobsPending() {
+	return jobs.pending > 0;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdbool.h>
+
+/*
+ * A small pool of worker threads for slow jobs that don't need GL, like decoding images.
+ * work runs on a worker, then finish runs on the GL thread the next time finishJobs is called
+ */
+typedef void (*JobFunc)(void* data);
+
+void initJobs();
+void destroyJobs();
+
+void submitJob(JobFunc work, JobFunc finish, void* data);
+void finishJobs();
+bool jobsPending();
@@ -1,10 +1,21 @@
 #include "level.h"
 #include "gl.h"
+#include "meshcache.h"
+#include "texcache.h"
+#include "renderqueue.h"
+
+#include <string.h>
+
+enum { grassCell, roadCell, sandCell, woodCell, n_level_cells };
+
+static const char* levelTextures[n_level_cells] = { "res/grass.png", "res/road.png", "res/sand.jpg", "res/wood.jpg" };
 
 /*
  * Initialize the road with all of the cars and the stuff we need to render them
  */
-static void initRoad(Road* road, float laneWidth, float laneHeight, size_t numLanes, Vec3f pos, DrawingFlags* flags) {
+static void initRoad(Road* road, float laneWidth, float laneHeight, size_t numLanes, Vec3f pos) {
+	// a snapshot has room for a fixed number of lanes
+	numLanes = min(numLanes, (size_t) maxLanes);
 	road->laneWidth = laneWidth;
 	road->laneHeight = laneHeight;
 	road->pos = pos;
@@ -14,9 +25,6 @@ static void initRoad(Road* road, float laneWidth, float laneHeight, size_t numLa
 	road->enemies = (Entity*) calloc(numLanes, sizeof(Entity));
 	Entity* enemy = road->enemies;
 	for (size_t i = 0; i < numLanes; ++i) {
-		// position the object randomly along the width of the lane
-		enemy->pos.x = getTRand(-5, 5);
-
 		// position the object in its own lane so it doesn't collide with others
 		enemy->pos.z = laneHeight / (float) numLanes * (float) i + road->pos.z;
 
@@ -30,12 +38,18 @@ static void initRoad(Road* road, float laneWidth, float laneHeight, size_t numLa
 		++enemy;
 	}
 
-	road->roadMesh = createPlane(laneWidth, laneHeight, flags->segments, flags->segments);
+	road->roadLod = createPlaneLod(laneWidth, laneHeight);
 	road->roadMaterial = (Material) { { 0.2, 0.2, 0.2, 0 }, { 0.5, 0.5, 0.5, 0 }, { 1, 1, 1, 0 }, 50 };
-	road->roadTexture = loadTexture("res/road.png");
 
-	road->cubeMesh = createCube();
-	road->cylinderMesh = createCylinder(flags->segments, flags->segments, 1);
+	road->cubeMesh = acquireCube();
+	road->wheelLod = createCylinderLod(1);
+
+	// every part of the car model fits inside a cube scaled by the car's size, sitting on the ground
+	for (size_t i = 0; i < numLanes; ++i) {
+		enemy = road->enemies + i;
+		enemy->boundsCenter = (Vec3f) { 0, enemy->size.y, 0 };
+		enemy->boundsRadius = getMeshRadius(road->cubeMesh, enemy->size);
+	}
 	road->redMaterial = (Material) { { 0.2, 0.2, 0.2, 0 }, { 1, 0, 0, 0 }, { 1, 1, 1, 0 }, 50 };
 	road->darkGrayMaterial = (Material) { { 0.2, 0.2, 0.2, 0 }, { 0.3, 0.3, 0.3, 0 }, { 1, 1, 1, 0 }, 50 };
 }
@@ -43,23 +57,21 @@ static void initRoad(Road* road, float laneWidth, float laneHeight, size_t numLa
 /*
  * Same as above but for our river and logs
  */
-static void initRiver(River* river, float laneWidth, float laneHeight, size_t numLanes, Vec3f pos, DrawingFlags* flags) {
+static void initRiver(River* river, float laneWidth, float laneHeight, size_t numLanes, Vec3f pos) {
+	// a snapshot has room for a fixed number of lanes
+	numLanes = min(numLanes, (size_t) maxLanes);
 	river->laneWidth = laneWidth;
 	river->laneHeight = laneHeight;
 	river->pos = pos;
 	river->numLanes = numLanes;
 
-	river->logMesh = createCylinder(flags->segments, flags->segments, 1);
+	river->logLod = createCylinderLod(1);
 	river->logMaterial = (Material) { { 0.2, 0.2, 0.2, 0 }, { 0.15, 0.02, 0.02, 0 }, { 1, 1, 1, 0 }, 40 };
-	river->logTexture = loadTexture("res/wood.jpg");
 
 	// allocate and initialize all of our objects
 	river->logs = (Entity*) calloc(numLanes, sizeof(Entity));
 	Entity* log = river->logs;
 	for (size_t i = 0; i < numLanes; ++i) {
-		// position the object randomly along the width of the lane
-		log->pos.x = getTRand(-5, 5);
-
 		// position the object in its own lane so it doesn't collide with others
 		log->pos.z = laneHeight / (float) numLanes * (float) i + river->pos.z;
 
@@ -72,27 +84,40 @@ static void initRiver(River* river, float laneWidth, float laneHeight, size_t nu
 		// we specified our cylinders looking down the z axis so we need to make sure they are rotated the right way when we draw them
 		log->rot.y = 90;
 		log->size = (Vec3f) { 0.1, 0.1, 0.5 };
+		log->boundsRadius = getMeshRadius(river->logLod->levels[0], log->size);
 		++log;
 	}
 
-	river->riverMesh = createPlane(laneWidth, laneHeight, flags->segments, flags->segments);
+	river->riverLod = createPlaneLod(laneWidth, laneHeight);
 	river->riverMaterial = (Material) { { 0.2, 0.2, 0.2, 0 }, { 0, 1, 1, 0.5 }, { 1, 1, 1, 0 }, 50 };
 	river->riverbedMaterial = (Material) { { 0.2, 0.2, 0.2, 0 }, { 0.58, 0.45, 0.26, 0 }, { 1, 1, 1, 0 }, 50 };
-	river->riverbedTexture = loadTexture("res/sand.jpg");
+}
+
+/*
+ * Scatter entities randomly along the width of their lanes
+ */
+static void placeEntities(Entity* entities, size_t numEntities) {
+	for (size_t i = 0; i < numEntities; ++i) {
+		entities[i].pos.x = getTRand(-5, 5);
+		entities[i].prevPos = entities[i].pos;
+	}
 }
 
 /*
  * Update an entity's position each frame and make sure it stays in the bounds specified
  */
 static void updateEntity(Entity* entity, float minX, float maxX, float dt) {
+	entity->prevPos = entity->pos;
 	entity->pos = addVec3f(entity->pos, mulVec3f(entity->vel, dt));
 
-	// make sure the object stays in bounds
+	// make sure the object stays in bounds, wrapping around is a jump so don't interpolate across it
 	if (entity->pos.x < minX) {
 		entity->pos.x = maxX;
+		entity->prevPos = entity->pos;
 	}
 	else if (entity->pos.x > maxX) {
 		entity->pos.x = minX;
+		entity->prevPos = entity->pos;
 	}
 }
 
@@ -121,166 +146,141 @@ static void updateRiver(River* river, float dt) {
 }
 
 /*
- * Render a car
+ * Check the bounding sphere of an entity drawn at pos against the camera's view
+ */
+static bool isEntityVisible(const Entity* entity, Vec3f pos, Camera* camera) {
+	return isSphereVisible(camera, addVec3f(pos, entity->boundsCenter), entity->boundsRadius);
+}
+
+/*
+ * Check the bounding sphere of a mesh drawn at pos against the camera's view
  */
-void renderCar(Mesh* cube, Mesh* cylinder, Material red, Material darkgray,
-				Entity* entity, DrawingFlags* flags) {
-	glPushAttrib(GL_CURRENT_BIT | GL_LIGHTING_BIT);
+static bool isMeshVisible(Mesh* mesh, Vec3f pos, Camera* camera) {
+	return isSphereVisible(camera, addVec3f(pos, mesh->center), mesh->radius);
+}
+
+/*
+ * Submit every part of every car the camera can see. Parts with the same mesh end up in one instanced draw,
+ * so the number of draw calls depends on the number of wheel LOD levels but not on the number of cars
+ */
+static void renderCars(Road* road, const Entity* cars, Camera* camera, DrawingFlags* flags, float alpha) {
+	static const Vec3f wheelPos[] = { { -0.5, 0.0, 0.8 }, { 0.5, 0.0, 0.8 }, { -0.5, 0.0, -0.8 }, { 0.5, 0.0, -0.8 } };
+	static const Vec3f wheelScale = { 0.3, 0.3, 0.4 };
+
+	DrawState bodyState = makeDrawState(&road->redMaterial, RED, flags);
+	DrawState wheelState = makeDrawState(&road->darkGrayMaterial, DARKGRAY, flags);
 
-	glPushMatrix();
-		glTranslatef(entity->pos.x, entity->pos.y, entity->pos.z);
-		glRotatef(entity->rot.x, 1, 0, 0);
-		glRotatef(entity->rot.y, 0, 1, 0);
-		glScalef(entity->size.x, entity->size.y, entity->size.z);
-		glTranslatef(0.0, 1.0, 0.0); // to be on the ground
+	for (size_t i = 0; i < road->numLanes; ++i) {
+		const Entity* entity = cars + i;
+		Vec3f pos = lerpVec3f(entity->prevPos, entity->pos, alpha);
+		if (!isEntityVisible(entity, pos, camera))
+			continue;
+
+		Mat4f car = identityMat4f();
+		car = translateMat4f(car, pos.x, pos.y, pos.z);
+		car = rotateMat4f(car, entity->rot.x, 1, 0, 0);
+		car = rotateMat4f(car, entity->rot.y, 0, 1, 0);
+		car = scaleMat4f(car, entity->size.x, entity->size.y, entity->size.z);
+		car = translateMat4f(car, 0.0, 1.0, 0.0); // to be on the ground
 
 		// car's body
-		glPushMatrix();
-			glTranslatef(0.0, -0.1, 0.0);
-			applyMaterial(&red);
-			submitColor(RED);
-			glScalef(1.0, 0.5, 0.8);
-			renderMesh(cube, flags);
-		glPopMatrix();
+		Mat4f body = translateMat4f(car, 0.0, -0.1, 0.0);
+		body = scaleMat4f(body, 1.0, 0.5, 0.8);
+		submitMesh(road->cubeMesh, &body, &bodyState);
 
 		// car's top
-		glPushMatrix();
-			glTranslatef(0.0, 0.7, 0.0);
-			applyMaterial(&red);
-			submitColor(RED);
-			glScalef(0.7, 0.3, 0.6);
-			renderMesh(cube, flags);
-		glPopMatrix();
-
-		// car's wheels
-		glPushMatrix();
-			glTranslatef(0.0, -0.7, 0.0);
-			// near left wheel
-			glPushMatrix();
-				glTranslatef(-0.5, 0.0, 0.8);
-				applyMaterial(&darkgray);
-				submitColor(DARKGRAY);
-				glScalef(0.3, 0.3, 0.4);
-				renderMesh(cylinder, flags);
-			glPopMatrix();
-
-			// near right wheel
-			glPushMatrix();
-				glTranslatef(0.5, 0.0, 0.8);
-				applyMaterial(&darkgray);
-				submitColor(DARKGRAY);
-				glScalef(0.3, 0.3, 0.4);
-				renderMesh(cylinder, flags);
-			glPopMatrix();
-
-			// far left wheel
-			glPushMatrix();
-				glTranslatef(-0.5, 0.0, -0.8);
-				applyMaterial(&darkgray);
-				submitColor(DARKGRAY);
-				glScalef(0.3, 0.3, 0.4);
-				renderMesh(cylinder, flags);
-			glPopMatrix();
-
-			// far right wheel
-			glPushMatrix();
-				glTranslatef(0.5, 0.0, -0.8);
-				applyMaterial(&darkgray);
-				submitColor(DARKGRAY);
-				glScalef(0.3, 0.3, 0.4);
-				renderMesh(cylinder, flags);
-			glPopMatrix();
-		glPopMatrix();
-	glPopMatrix();
-
-	glPopAttrib();
+		Mat4f top = translateMat4f(car, 0.0, 0.7, 0.0);
+		top = scaleMat4f(top, 0.7, 0.3, 0.6);
+		submitMesh(road->cubeMesh, &top, &bodyState);
+
+		// all four wheels of a car are close enough together to share a level of detail
+		Vec3f wheelSize = { entity->size.x * wheelScale.x, entity->size.y * wheelScale.y, entity->size.z * wheelScale.z };
+		float wheelRadius = getMeshRadius(road->wheelLod->levels[0], wheelSize);
+		Mesh* wheelMesh = selectLod(road->wheelLod, camera, pos, wheelRadius, flags);
+		for (size_t j = 0; j < 4; ++j) {
+			Mat4f wheel = translateMat4f(car, wheelPos[j].x, wheelPos[j].y - 0.7, wheelPos[j].z);
+			wheel = scaleMat4f(wheel, wheelScale.x, wheelScale.y, wheelScale.z);
+			submitMesh(wheelMesh, &wheel, &wheelState);
+		}
+	}
 }
 
 /*
- * Render a log object with the provided mesh
+ * The transform for an entity's mesh drawn at pos
  */
-static void renderEntity(Entity* entity, Mesh* mesh, DrawingFlags* flags) {
-	glPushMatrix();
-	glTranslatef(entity->pos.x, entity->pos.y, entity->pos.z);
-	glRotatef(entity->rot.x, 1, 0, 0);
-	glRotatef(entity->rot.y, 0, 1, 0);
-	glScalef(entity->size.x, entity->size.y, entity->size.z);
-	renderMesh(mesh, flags);
-	glPopMatrix();
+static Mat4f getEntityTransform(const Entity* entity, Vec3f pos) {
+	Mat4f m = identityMat4f();
+	m = translateMat4f(m, pos.x, pos.y, pos.z);
+	m = rotateMat4f(m, entity->rot.x, 1, 0, 0);
+	m = rotateMat4f(m, entity->rot.y, 0, 1, 0);
+	return scaleMat4f(m, entity->size.x, entity->size.y, entity->size.z);
 }
 
 /*
- * Get the material and mesh for all of our cars and render them
+ * Submit the road surface, textured from its cell of the level's atlas
  */
-static void renderRoad(Road* road, DrawingFlags* flags) {
-	glPushAttrib(GL_CURRENT_BIT | GL_LIGHTING_BIT);
-
-	for (size_t i = 0; i < road->numLanes; ++i) {
-		renderCar(road->cubeMesh, road->cylinderMesh,
-			road->redMaterial, road->darkGrayMaterial,
-			road->enemies + i, flags);
-	}
-
-	glBindTexture(GL_TEXTURE_2D, road->roadTexture);
-	applyMaterial(&road->roadMaterial);
-	submitColor(GRAY);
-	
-	glPushMatrix();
-	glTranslatef(road->pos.x, road->pos.y + 0.001, road->pos.z + road->laneHeight / 2 - road->enemies->size.z);
-	renderMesh(road->roadMesh, flags);
-	glPopMatrix();
+static void renderRoad(Road* road, unsigned int atlas, Camera* camera, DrawingFlags* flags) {
+	Vec3f pos = { road->pos.x, road->pos.y + 0.001, road->pos.z + road->laneHeight / 2 - road->enemies->size.z };
+	if (!isMeshVisible(road->roadLod->levels[0], pos, camera))
+		return;
 
-	glBindTexture(GL_TEXTURE_2D, 0);
+	DrawState state = makeDrawState(&road->roadMaterial, GRAY, flags);
+	state.texture = atlas;
+	state.atlasCell = roadCell;
 
-	glPopAttrib();
+	Mat4f m = translateMat4f(identityMat4f(), pos.x, pos.y, pos.z);
+	submitMesh(selectLod(road->roadLod, camera, pos, road->roadLod->levels[0]->radius, flags), &m, &state);
 }
 
 /*
- * And the same as above for our logs
+ * And the same as above for the riverbed, water and logs
  */
-static void renderRiver(River* river, DrawingFlags* flags) {
-	glPushAttrib(GL_CURRENT_BIT | GL_LIGHTING_BIT);
-
-	glPushMatrix();
-	glTranslatef(river->pos.x, river->pos.y + 0.001, river->pos.z + river->laneHeight / 2 - river->logs->size.x);
-	glBindTexture(GL_TEXTURE_2D, river->riverbedTexture);
-	applyMaterial(&river->riverbedMaterial);
-	submitColor(SAND);
-	renderMesh(river->riverMesh, flags);
-	glBindTexture(GL_TEXTURE_2D, 0);
-	
-	glTranslatef(0.0, 0.001, 0.0);
-	glDisable(GL_DEPTH_TEST);
-	glEnable(GL_BLEND);	
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	applyMaterial(&river->riverMaterial);
-	glColor4f(0, 1, 1, 0.5);
-	renderMesh(river->riverMesh, flags);
-	glDisable(GL_BLEND);
-	glEnable(GL_DEPTH_TEST);
-	glPopMatrix();
+static void renderRiver(River* river, const Entity* logs, unsigned int atlas, Camera* camera, DrawingFlags* flags, float alpha) {
+	Vec3f pos = { river->pos.x, river->pos.y + 0.001, river->pos.z + river->laneHeight / 2 - river->logs->size.x };
+	if (isMeshVisible(river->riverLod->levels[0], pos, camera)) {
+		Mesh* riverMesh = selectLod(river->riverLod, camera, pos, river->riverLod->levels[0]->radius, flags);
+
+		DrawState bedState = makeDrawState(&river->riverbedMaterial, SAND, flags);
+		bedState.texture = atlas;
+		bedState.atlasCell = sandCell;
+		Mat4f bed = translateMat4f(identityMat4f(), pos.x, pos.y, pos.z);
+		submitMesh(riverMesh, &bed, &bedState);
+
+		// the water is see-through and untextured. It's depth tested now, and the bed is only a hair below it,
+		// so it's biased forwards to stay in front of the bed at any distance
+		DrawState waterState = makeDrawState(&river->riverMaterial, CYAN, flags);
+		waterState.color.w = 0.5;
+		waterState.flags.textures = false;
+		waterState.layer = transparentLayer;
+		waterState.depthBias = -1;
+		Mat4f water = translateMat4f(bed, 0.0, 0.001, 0.0);
+		submitMesh(riverMesh, &water, &waterState);
+	}
 
+	DrawState logState = makeDrawState(&river->logMaterial, BROWN, flags);
+	logState.texture = atlas;
+	logState.atlasCell = woodCell;
 	for (size_t i = 0; i < river->numLanes; ++i) {
-		glBindTexture(GL_TEXTURE_2D, river->logTexture);
-		applyMaterial(&river->logMaterial);
-		submitColor(BROWN);
-		renderEntity(river->logs + i, river->logMesh, flags);
-		glBindTexture(GL_TEXTURE_2D, 0);
+		const Entity* log = logs + i;
+		Vec3f pos = lerpVec3f(log->prevPos, log->pos, alpha);
+		if (!isEntityVisible(log, pos, camera))
+			continue;
+		Mat4f m = getEntityTransform(log, pos);
+		submitMesh(selectLod(river->logLod, camera, pos, log->boundsRadius, flags), &m, &logState);
 	}
-
-	glPopAttrib();
 }
 
-static void renderTerrain(Level* level, DrawingFlags* flags) {
-	glPushAttrib(GL_CURRENT_BIT | GL_LIGHTING_BIT);
-	
-	glBindTexture(GL_TEXTURE_2D, level->terrainTexture);
-	applyMaterial(&level->terrainMaterial);
-	submitColor(GREEN);
-	renderMesh(level->terrainMesh, flags);
-	glBindTexture(GL_TEXTURE_2D, 0);
-	
-	glPopAttrib();
+static void renderTerrain(Level* level, Camera* camera, DrawingFlags* flags) {
+	Mesh* terrainMesh = level->terrainLod->levels[0];
+	if (!isMeshVisible(terrainMesh, (Vec3f) { 0, 0, 0 }, camera))
+		return;
+
+	DrawState state = makeDrawState(&level->terrainMaterial, GREEN, flags);
+	state.texture = level->atlas;
+	state.atlasCell = grassCell;
+
+	Mat4f m = identityMat4f();
+	submitMesh(selectLod(level->terrainLod, camera, terrainMesh->center, terrainMesh->radius, flags), &m, &state);
 }
 
 /*
@@ -288,9 +288,9 @@ static void renderTerrain(Level* level, DrawingFlags* flags) {
  */
 static void destroyRoad(Road* road) {
 	free(road->enemies);
-	destroyMesh(road->roadMesh);
-	destroyMesh(road->cubeMesh);
-	destroyMesh(road->cylinderMesh);
+	destroyMeshLod(road->roadLod);
+	releaseMesh(road->cubeMesh);
+	destroyMeshLod(road->wheelLod);
 }
 
 /*
@@ -298,43 +298,32 @@ static void destroyRoad(Road* road) {
  */
 static void destroyRiver(River* river) {
 	free(river->logs);
-	destroyMesh(river->logMesh);
-	destroyMesh(river->riverMesh);
-}
-
-/*
- * Generate the geometry used by the terrain and the logs.
- * Just done this way so we have an easy way to update the geometry after the tesselation is increased or decreased
- */
-void generateLevelGeometry(Level* level, size_t segments) {
-	if (level->terrainMesh)
-		destroyMesh(level->terrainMesh);
-	if (level->river.logMesh)
-		destroyMesh(level->river.logMesh);
-	if (level->river.riverMesh)
-		destroyMesh(level->river.riverMesh);
-	if (level->road.roadMesh)
-		destroyMesh(level->road.roadMesh);
-
-	level->terrainMesh = createPlane(level->width, level->height, segments, segments);
-	level->river.logMesh = createCylinder(segments, segments, 1);
-	level->river.riverMesh = createPlane(level->river.laneWidth, level->river.laneHeight, segments, segments);
-	level->road.roadMesh = createPlane(level->road.laneWidth, level->road.laneHeight, segments, segments);
+	destroyMeshLod(river->logLod);
+	destroyMeshLod(river->riverLod);
 }
 
 /*
  * Initialize all of the stuff we need for the game world
  */
-void initLevel(Level* level, DrawingFlags* flags) {
+void initLevel(Level* level) {
 	level->width = 10;
 	level->height = 10;
 
-	level->terrainMesh = createPlane(level->width, level->height, flags->segments, flags->segments);
-	level->terrainTexture = loadTexture("res/grass.png");
+	level->terrainLod = createPlaneLod(level->width, level->height);
+	level->atlas = acquireAtlas(levelTextures, n_level_cells);
 	level->terrainMaterial = (Material) { { 0.2, 0.2, 0.2, 0 }, { 0, 1, 0, 0 }, { 0.3, 0.3, 0.3, 0 }, 20 };
 
-	initRoad(&level->road, level->width, 1.75, 8, (Vec3f) { 0, 0, 1 }, flags);
-	initRiver(&level->river, level->width, 1.75, 8, (Vec3f) { 0, 0, -3 }, flags);
+	initRoad(&level->road, level->width, 1.75, 8, (Vec3f) { 0, 0, 1 });
+	initRiver(&level->river, level->width, 1.75, 8, (Vec3f) { 0, 0, -3 });
+	resetLevel(level);
+}
+
+/*
+ * Put the cars and logs back at random spots in their lanes. It only touches the entities, so it's safe on the simulation thread
+ */
+void resetLevel(Level* level) {
+	placeEntities(level->road.enemies, level->road.numLanes);
+	placeEntities(level->river.logs, level->river.numLanes);
 }
 
 /*
@@ -343,7 +332,8 @@ void initLevel(Level* level, DrawingFlags* flags) {
 void destroyLevel(Level* level) {
 	destroyRoad(&level->road);
 	destroyRiver(&level->river);
-	destroyMesh(level->terrainMesh);
+	destroyMeshLod(level->terrainLod);
+	releaseTexture(level->atlas);
 }
 
 /*
@@ -355,10 +345,20 @@ void updateLevel(Level* level, float dt) {
 }
 
 /*
- * Render everything in the game world
+ * Copy out the cars and logs for a snapshot
+ */
+void saveLevelState(Level* level, LevelState* state) {
+	memcpy(state->cars, level->road.enemies, level->road.numLanes * sizeof(Entity));
+	memcpy(state->logs, level->river.logs, level->river.numLanes * sizeof(Entity));
+}
+
+/*
+ * Submit everything in the game world that the camera can see to the render queue, with the cars and logs from a snapshot.
+ * They are drawn alpha of the way from where they were before the last step to where they are now
  */
-void renderLevel(Level* level, DrawingFlags* flags) {
-	renderRiver(&level->river, flags);
-	renderRoad(&level->road, flags);
-	renderTerrain(level, flags);
+void renderLevel(Level* level, const LevelState* state, Camera* camera, DrawingFlags* flags, float alpha) {
+	renderCars(&level->road, state->cars, camera, flags, alpha);
+	renderRiver(&level->river, state->logs, level->atlas, camera, flags, alpha);
+	renderRoad(&level->road, level->atlas, camera, flags);
+	renderTerrain(level, camera, flags);
 }
@@ -3,13 +3,21 @@
 #include "util.h"
 #include "mesh.h"
 #include "material.h"
+#include "camera.h"
+#include "lod.h"
+
+enum { maxLanes = 16 };
 
 /*
  * An object we can use to store the size, position and velocity of both the logs and cars in our game
+ * The bounding sphere is worked out once when the entity is created, its center is relative to pos
+ * prevPos is where the entity was before the last simulation step, it's drawn somewhere between the two
  */
 typedef struct {
-	Vec3f pos, vel, size;
+	Vec3f pos, prevPos, vel, size;
 	Vec2f rot;
+	Vec3f boundsCenter;
+	float boundsRadius;
 } Entity;
 
 /*
@@ -21,13 +29,12 @@ typedef struct {
 	float laneWidth, laneHeight;
 	Vec3f pos;
 	Mesh* cubeMesh;
-	Mesh* cylinderMesh;
+	MeshLod* wheelLod;
 	Material redMaterial;
 	Material darkGrayMaterial;
 	Entity* enemies;
-	Mesh* roadMesh;
+	MeshLod* roadLod;
 	Material roadMaterial;
-	unsigned int roadTexture;
 } Road;
 
 /*
@@ -38,29 +45,38 @@ typedef struct {
 	float laneWidth, laneHeight;
 	Vec3f pos;
 	Entity* logs;
-	Mesh* logMesh;
+	MeshLod* logLod;
 	Material logMaterial;
-	unsigned int logTexture;
-	Mesh* riverMesh;
+	MeshLod* riverLod;
 	Material riverMaterial;
 	Material riverbedMaterial;
-	unsigned int riverbedTexture;
 } River;
 
 /*
  * Bundles up of the state for our game, including a mesh and material for our play area
+ * All of the tessellated shapes come as LOD chains, the level picks one for each object as it's drawn
+ * The terrain, road, riverbed and logs are all textured from cells of one atlas
  */
 typedef struct {
 	int width, height;
-	Mesh* terrainMesh;
+	MeshLod* terrainLod;
 	Material terrainMaterial;
-	unsigned int terrainTexture;
+	unsigned int atlas;
 	Road road;
 	River river;
 } Level;
 
-void generateLevelGeometry(Level* level, size_t segments); 
-void initLevel(Level* level, DrawingFlags* flags);
+/*
+ * The part of the level that the simulation changes, copied out into each snapshot for the render thread
+ */
+typedef struct {
+	Entity cars[maxLanes];
+	Entity logs[maxLanes];
+} LevelState;
+
+void initLevel(Level* level);
+void resetLevel(Level* level);
 void destroyLevel(Level* level);
 void updateLevel(Level* level, float dt);
-void renderLevel(Level* level, DrawingFlags* flags);
+void saveLevelState(Level* level, LevelState* state);
+void renderLevel(Level* level, const LevelState* state, Camera* camera, DrawingFlags* flags, float alpha);
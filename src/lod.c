@@ -0,0 +1,69 @@
+#include "lod.h"
+#include "meshcache.h"
+
+MeshLod* createPlaneLod(float width, float height) {
+	MeshLod* lod = (MeshLod*) malloc(sizeof(MeshLod));
+	lod->numLevels = maxLods;
+	lod->flat = true;
+	for (size_t i = 0; i < lod->numLevels; ++i) {
+		size_t segments = minLodSegments << i;
+		lod->levels[i] = acquirePlane(width, height, segments, segments);
+	}
+	return lod;
+}
+
+MeshLod* createCylinderLod(float radius) {
+	MeshLod* lod = (MeshLod*) malloc(sizeof(MeshLod));
+	lod->numLevels = maxLods;
+	lod->flat = false;
+	for (size_t i = 0; i < lod->numLevels; ++i) {
+		size_t segments = minLodSegments << i;
+		lod->levels[i] = acquireCylinder(segments, segments, radius);
+	}
+	return lod;
+}
+
+void destroyMeshLod(MeshLod* lod) {
+	if (lod) {
+		for (size_t i = 0; i < lod->numLevels; ++i)
+			releaseMesh(lod->levels[i]);
+		free(lod);
+	}
+}
+
+/*
+ * The level with the number of segments the flag asks for, or the closest one there is
+ */
+static size_t getBiasLevel(MeshLod* lod, DrawingFlags* flags) {
+	size_t level = 0;
+	while (level + 1 < lod->numLevels && (size_t) (minLodSegments << level) < flags->segments)
+		++level;
+	return level;
+}
+
+/*
+ * Pick the level of detail for an object with a world space bounding sphere.
+ * The segments flag is the quality bias: at the default of 8, an object 128 pixels across gets 8 segments,
+ * and each doubling of the flag doubles the segments every object asks for.
+ * A flat shape looks the same at any tessellation, and its bounding sphere says nothing about how much of it is near,
+ * so flat chains and objects the camera is inside just get the level the bias asks for
+ */
+size_t selectLodLevel(MeshLod* lod, Camera* camera, Vec3f center, float radius, DrawingFlags* flags) {
+	Vec3f d = { center.x - camera->eye.x, center.y - camera->eye.y, center.z - camera->eye.z };
+	float distance = magVec3f(d);
+
+	if (lod->flat || distance <= radius)
+		return getBiasLevel(lod, flags);
+
+	float pixels = 2.0 * radius * camera->pixelsPerUnit / distance;
+	float wanted = pixels * flags->segments / 128.0;
+
+	size_t level = 0;
+	while (level + 1 < lod->numLevels && (float) (minLodSegments << level) < wanted)
+		++level;
+	return level;
+}
+
+Mesh* selectLod(MeshLod* lod, Camera* camera, Vec3f center, float radius, DrawingFlags* flags) {
+	return lod->levels[selectLodLevel(lod, camera, center, radius, flags)];
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "mesh.h"
+#include "camera.h"
+
+enum { minLodSegments = 8, maxLods = 6 };
+
+/*
+ * A procedural shape generated at several tessellations, level i has minLodSegments << i segments.
+ * renderers pick the level to draw for each object from how big it is on the screen.
+ * The levels come from the mesh cache, so chains of the same shape share their meshes.
+ * flat is set for planes, which only need more segments for finer lighting and never for their silhouette
+ */
+typedef struct {
+	Mesh* levels[maxLods];
+	size_t numLevels;
+	bool flat;
+} MeshLod;
+
+MeshLod* createPlaneLod(float width, float height);
+MeshLod* createCylinderLod(float radius);
+void destroyMeshLod(MeshLod* lod);
+
+size_t selectLodLevel(MeshLod* lod, Camera* camera, Vec3f center, float radius, DrawingFlags* flags);
+Mesh* selectLod(MeshLod* lod, Camera* camera, Vec3f center, float radius, DrawingFlags* flags);
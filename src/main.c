@@ -6,6 +6,21 @@
 #include "anim.h"
 #include "skybox.h"
 #include "particles.h"
+#include "text.h"
+#include "meshcache.h"
+#include "texcache.h"
+#include "jobs.h"
+#include "archive.h"
+#include "glstate.h"
+#include "renderqueue.h"
+#include "shader.h"
+#include "stream.h"
+#include "sim.h"
+#include "ticker.h"
+#include "pacer.h"
+#include "timing.h"
+
+#include <string.h>
 
 /*
 ------------------------------------
@@ -22,11 +37,61 @@ Student ID  : s3558475
 
 Globals globals;
 
+/*
+ * Steps per second of the simulation, and frames per second to draw at most
+ */
+enum { defaultTickRate = 60, defaultFrameRate = 60 };
+
+#define WAKE_TIME 0.5 // seconds to keep drawing after input, long enough for the simulation to pick it up and start moving again
+
+static void update();
+
 static void cleanup() {
+	// the simulation thread has to let go of the player, level and particles before they're destroyed
+	stopSim();
+	dumpTimings(globals.timingsPath);
+
+	unsigned int droppedKeys = countDroppedInput(&globals.keys), droppedMouse = countDroppedInput(&globals.mouse);
+	if (droppedKeys || droppedMouse)
+		printf("Dropped %u key and %u mouse events because the input queues were full\n", droppedKeys, droppedMouse);
+	destroyText(&globals.osd);
 	destroyParticles(&globals.particles);
 	destroySkybox(&globals.skybox);
 	destroyPlayer(&globals.player);
 	destroyLevel(&globals.level);
+	destroyRenderQueue();
+	destroyShaders();
+	destroyStream();
+	destroyMeshCache();
+	destroyJobs();
+	destroyTextureCache();
+	closeBakedTextures();
+	closeAssets();
+}
+
+/*
+ * Start drawing again straight away if we had stopped, and keep going for a while in case the input starts something moving
+ */
+static void wakeUp()
+{
+	globals.lastInputT = getClockTime();
+	if (globals.sleeping) {
+		globals.sleeping = false;
+		resetPacer();
+		skipPresentInterval();
+		glutIdleFunc(update);
+		glutPostRedisplay();
+	}
+}
+
+/*
+ * Send the simulation an event, stamped with when it happened so it lands in the right step
+ */
+static void sendInput(InputQueue* queue, int type, int control, bool down, int x, int y)
+{
+	InputEvent event = { type, getClockTime(), control, down, x, y };
+	pushInput(queue, &event);
+	wakeUp();
 }
 
 static void updateKeyChar(unsigned char key, bool state)
@@ -34,19 +99,20 @@ static void updateKeyChar(unsigned char key, bool state)
 	switch (key)
 	{
 		case 'w':
-			globals.controls.up = state;
+			sendInput(&globals.keys, controlInput, upControl, state, 0, 0);
 			break;
 		case 's':
-			globals.controls.down = state;
+			sendInput(&globals.keys, controlInput, downControl, state, 0, 0);
 			break;
 		case 'a':
-			globals.controls.left = state;
+			sendInput(&globals.keys, controlInput, leftControl, state, 0, 0);
 			break;
 		case 'd':
-			globals.controls.right = state;
+			sendInput(&globals.keys, controlInput, rightControl, state, 0, 0);
 			break;
 		case ' ':
-			globals.controls.jump = state;
+			sendInput(&globals.keys, controlInput, jumpControl, state, 0, 0);
+			break;
 		default:
 			break;
 	}
@@ -55,16 +121,78 @@ static void updateKeyChar(unsigned char key, bool state)
 static void updateKeyInt(int key, bool state) {
 	switch (key) {
 		case GLUT_KEY_LEFT:
-			globals.controls.turnLeft = state;
+			sendInput(&globals.keys, controlInput, turnLeftControl, state, 0, 0);
 			break;
 		case GLUT_KEY_RIGHT:
-			globals.controls.turnRight = state;
+			sendInput(&globals.keys, controlInput, turnRightControl, state, 0, 0);
 			break;
 		default:
 			break;
 	}
 }
 
+/*
+ * The mouse only moves the camera, so its events are queued for the start of the next frame rather than the simulation.
+ * While we're awake the idle callback asks for a redraw every frame, so the input callbacks only need to wake us up
+ */
+static void mouseMotion(int x, int y) {
+	sendInput(&globals.mouse, motionInput, 0, false, x, y);
+}
+
+static void mouseButton(int button, int state, int x, int y) {
+	sendInput(&globals.mouse, buttonInput, button, state == GLUT_DOWN, x, y);
+}
+
+/*
+ * Turn and zoom the camera by how far the mouse was dragged to (x, y)
+ */
+static void dragCamera(int x, int y) {
+	int dX = x - globals.camera.lastX;
+	int dY = y - globals.camera.lastY;
+
+	if (globals.controls.lmb) {
+		globals.camera.xRot += dX * 0.1;
+		globals.camera.yRot += dY * 0.1;
+		globals.camera.yRot = clamp(globals.camera.yRot, 0, 90);
+	}
+	
+	if (globals.controls.rmb) {
+		globals.camera.zoom += dY * 0.01;
+		globals.camera.zoom = max(globals.camera.zoom, 0.5);
+	}
+
+	globals.camera.lastX = x;
+	globals.camera.lastY = y;
+}
+
+/*
+ * Apply the mouse events since the last frame. A run of motion events in a row comes down to the last one,
+ * so a drag costs one camera update a frame however many events it sent
+ */
+static void updateMouse() {
+	const InputEvent* event;
+	while ((event = peekInput(&globals.mouse))) {
+		InputEvent e = *event;
+		popInput(&globals.mouse);
+
+		if (e.type == motionInput) {
+			const InputEvent* next = peekInput(&globals.mouse);
+			if (!next || next->type != motionInput)
+				dragCamera(e.x, e.y);
+			continue;
+		}
+
+		if (e.down) {
+			globals.camera.lastX = e.x;
+			globals.camera.lastY = e.y;
+		}
+		if (e.control == GLUT_LEFT_BUTTON)
+			globals.controls.lmb = e.down;
+		else if (e.control == GLUT_RIGHT_BUTTON)
+			globals.controls.rmb = e.down;
+	}
+}
+
 static void reshape(int width, int height) {
 	glViewport(0,0, width, height);
 	globals.camera.width = width;
@@ -72,303 +200,143 @@ static void reshape(int width, int height) {
 	applyProjectionMatrix(&globals.camera);
 }
 
-void renderOSD()
+/*
+ * The OSD only changes when one of its strings or the window size changes, the text module
+ * takes care of rebuilding the quads then and draws everything in one go
+ */
+void renderOSD(const Snapshot* snapshot)
 {
-	char buffer[30];
-	char *bufp;
-	int w, h, count;
+	char buffer[32];
+	int count;
+	int w = globals.camera.width;
+	int h = globals.camera.height;
 	int textPosY = 15;
 
-	glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
-	glDisable(GL_DEPTH_TEST);
-	glDisable(GL_LIGHTING);
-
-	glMatrixMode(GL_PROJECTION);
-	glPushMatrix();
-	glLoadIdentity();
+	/* Frame rate, from the median time between swaps */
+	TimingStats* present = &globals.timings[presentTiming];
+	snprintf(buffer, sizeof buffer, "fr (f/s): %6.0f", present->p50 > 0 ? 1000.0 / present->p50 : 0.0);
+	setTextLine(&globals.osd, 0, fixedFont, YELLOW, 10, 60, buffer);
 
-	/* Set up orthographic coordinate system to match the 
-	 window, i.e. (0,0)-(w,h) */
-	w = glutGet(GLUT_WINDOW_WIDTH);
-	h = glutGet(GLUT_WINDOW_HEIGHT);
-	glOrtho(0.0, w, 0.0, h, -1.0, 1.0);
+	/* Time per frame */
+	snprintf(buffer, sizeof buffer, "ft (ms/f): %5.1f", present->p50);
+	setTextLine(&globals.osd, 1, fixedFont, YELLOW, 10, 40, buffer);
+
+	/* Percentiles of the time between swaps and the CPU time spent updating and rendering, over the last frames */
+	static const char* timingLabels[n_timings] = { "update", "render", "frame " };
+	snprintf(buffer, sizeof buffer, "ms       p50   p95   p99   max");
+	setTextLine(&globals.osd, 8, fixedFont, YELLOW, 10, 160, buffer);
+	for (int i = 0; i < n_timings; ++i) {
+		TimingStats* t = &globals.timings[i];
+		snprintf(buffer, sizeof buffer, "%s%6.1f%6.1f%6.1f%6.1f", timingLabels[i], t->p50, t->p95, t->p99, t->max);
+		setTextLine(&globals.osd, 9 + i, fixedFont, YELLOW, 10, 100 + i * 20, buffer);
+	}
 
-	glMatrixMode(GL_MODELVIEW);
-	glPushMatrix();
-	glLoadIdentity();
+	/* Objects drawn and culled against the view frustum */
+	snprintf(buffer, sizeof buffer, "drawn: %d culled: %d", globals.camera.numDrawn, globals.camera.numCulled);
+	setTextLine(&globals.osd, 6, fixedFont, YELLOW, 10, 20, buffer);
 
-	/* Frame rate */
-	submitColor(YELLOW);
-	glRasterPos2i(10, 60);
-	snprintf(buffer, sizeof buffer, "fr (f/s): %6.0f", globals.frameRate);
-	for (bufp = buffer; *bufp; bufp++)
-		glutBitmapCharacter(GLUT_BITMAP_9_BY_15, *bufp);
-
-	/* Time per frame */
-	submitColor(YELLOW);
-	glRasterPos2i(10, 40);
-	snprintf(buffer, sizeof buffer, "ft (ms/f): %5.0f", 1.0 / globals.frameRate * 1000.0);
-	for (bufp = buffer; *bufp; bufp++)
-		glutBitmapCharacter(GLUT_BITMAP_9_BY_15, *bufp);
+	/* State changes sent to GL and skipped as redundant so far this frame */
+	GLStateStats stats = getGLStateStats();
+	snprintf(buffer, sizeof buffer, "state: %d set %d skipped", stats.issued, stats.skipped);
+	setTextLine(&globals.osd, 7, fixedFont, YELLOW, 10, 80, buffer);
 
 	/* Name */
-	submitColor(GREEN);
 	count = snprintf(buffer, sizeof buffer, "Frogger");
-	glRasterPos2f((w - count * 9)/ 2.0 , h - textPosY);
+	setTextLine(&globals.osd, 2, fixedFont, GREEN, (w - count * 9) / 2.0, h - textPosY, buffer);
 	textPosY += 18;
-	for (bufp = buffer; *bufp; bufp++)
-		glutBitmapCharacter(GLUT_BITMAP_9_BY_15, *bufp);
-	
+
 	/* Lives left */
-	submitColor(GREEN);
-	count = snprintf(buffer, sizeof buffer, "Lives left: %d", globals.lives);
-	glRasterPos2f((w - count * 9)/ 2.0 , h - textPosY);
+	count = snprintf(buffer, sizeof buffer, "Lives left: %d", snapshot->lives);
+	setTextLine(&globals.osd, 3, fixedFont, GREEN, (w - count * 9) / 2.0, h - textPosY, buffer);
 	textPosY += 18;
-	for (bufp = buffer; *bufp; bufp++)
-		glutBitmapCharacter(GLUT_BITMAP_9_BY_15, *bufp);
 
 	/* Score */
-	submitColor(GREEN);
-	count = snprintf(buffer, sizeof buffer, "Score: %d", globals.score);
-	glRasterPos2f((w - count * 9)/ 2.0 , h - textPosY);
+	count = snprintf(buffer, sizeof buffer, "Score: %d", snapshot->score);
+	setTextLine(&globals.osd, 4, fixedFont, GREEN, (w - count * 9) / 2.0, h - textPosY, buffer);
 	textPosY += 18;
-	for (bufp = buffer; *bufp; bufp++)
-		glutBitmapCharacter(GLUT_BITMAP_9_BY_15, *bufp);
 
 	/* Game Over */
-	if (globals.lives == 0) {
-		submitColor(PURPLE);
-		count = snprintf(buffer, sizeof buffer, "Game Over");
-		glRasterPos2f((w - count * 9)/ 2.0 , h / 2 + 12);
-		for (bufp = buffer; *bufp; bufp++)
-			glutBitmapCharacter(GLUT_BITMAP_TIMES_ROMAN_24, *bufp);
-	}
-	/* Pop modelview */
-	glPopMatrix();  
-	glMatrixMode(GL_PROJECTION);
+	count = snprintf(buffer, sizeof buffer, "%s", snapshot->lives == 0 ? "Game Over" : "");
+	setTextLine(&globals.osd, 5, titleFont, PURPLE, (w - count * 9) / 2.0, h / 2 + 12, buffer);
 
-	/* Pop projection */
-	glPopMatrix();  
-	glMatrixMode(GL_MODELVIEW);
-
-	/* Pop attributes */
-	glPopAttrib();
+	renderText(&globals.osd, w, h);
 }
 
 static void render()
 {
+	double start = getClockTime();
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	beginStreamFrame();
+	resetGLStateStats();
 
-	applyViewMatrix(&globals.camera);
-
-	static float lightPos[] = { 1, 1, 1, 0 };
-	glLightfv(GL_LIGHT0, GL_POSITION, lightPos);
-
-	glPushMatrix();
-		glLoadIdentity();
-		glRotatef(globals.camera.yRot, 1, 0, 0);
-		glRotatef(globals.camera.xRot, 0, 1, 0);
-		renderSkybox(&globals.skybox, &globals.drawingFlags);
-	glPopMatrix();
-
-	renderLevel(&globals.level, &globals.drawingFlags);
-	renderPlayer(&globals.player, &globals.drawingFlags);
-	if (globals.particles.spawn) {
-		renderParticles(&globals.particles, &globals.drawingFlags);
-	}
-
-	renderOSD();
-
-	glutSwapBuffers();
-	globals.frames++;
-}
-
-static void resetGame()
-{
-	initCamera(&globals.camera);
-	initPlayer(&globals.player);
-	initLevel(&globals.level, &globals.drawingFlags);
-	globals.camera.pos = globals.player.pos;
-}
-
-static void checkCrossRiver()
-{
-	River river = globals.level.river;
-	float riverSidePos = river.pos.z - river.logs->size.x;
-	if (globals.player.pos.z < riverSidePos) {
-		globals.score++;
-		resetGame();
-	}
-}
-
-static void checkInRiver()
-{
-	River river = globals.level.river;
-	float riverTopSide = river.pos.z - river.logs->size.x;
-	float riverBottomSide = river.pos.z + river.laneHeight - river.logs->size.x;
-	if (globals.player.pos.y == 0 && !globals.player.onLog &&
-			globals.player.pos.z > riverTopSide && globals.player.pos.z < riverBottomSide) {
-		globals.lives--;
-		resetGame();
-	}
-}
+	updateMouse();
 
-static void attachFrogOnLog(Entity log)
-{
-	Player * frog = &globals.player;
-	static Vec3f posOnLog = { 0.0, 0.0, 0.0 };
-	static bool isJump = false;
-	if (!frog->onLog) {
-		posOnLog = (Vec3f) {log.pos.x - frog->pos.x, log.pos.y - frog->pos.y, log.pos.z - frog->pos.z};
-		frog->onLog = true;
-		isJump = frog->jump;
+	// the snapshot can't change under us, and everything is drawn between its last two states by how far we are past it
+	const Snapshot* snapshot = acquireSnapshot();
+	float alpha = clamp((getClockTime() - snapshot->time) / snapshot->step, 0.0, 1.0);
+	if (snapshot->resets != globals.resets) {
+		initCamera(&globals.camera);
+		globals.resets = snapshot->resets;
 	}
+	globals.animating = !snapshot->halted;
 
-	// skip the jump which moves to the log
-	if (isJump) { 
-		if (frog->jump) {
-			return;
-		} else {
-			isJump = frog->jump;
-		}
+	// the game is updated on the simulation thread, so its update time is whatever its latest batch of steps took
+	if (snapshot->batches != globals.batches) {
+		recordTiming(updateTiming, snapshot->batchTime);
+		globals.batches = snapshot->batches;
 	}
+	globals.camera.pos = lerpVec3f(snapshot->player.prevPos, snapshot->player.pos, alpha);
+	applyViewMatrix(&globals.camera);
 
-	if (!frog->jump) {
-		frog->pos.x = log.pos.x - posOnLog.x;
-		frog->pos.y = log.pos.y - posOnLog.y;
-		frog->pos.z = log.pos.z - posOnLog.z;
-		frog->initPos = frog->pos;
-	} else {
-		frog->onLog = false;
+	static float lightPos[] = { 1, 1, 1, 0 };
+	glLightfv(GL_LIGHT0, GL_POSITION, lightPos);
+	if (shadersEnabled())
+		beginShaderFrame(&globals.camera, lightPos);
+
+	// everything is collected into the queue first, then sorted by state and drawn in one go
+	beginRenderQueue(&globals.camera);
+	renderLevel(&globals.level, &snapshot->level, &globals.camera, &globals.drawingFlags, alpha);
+	renderPlayer(&globals.player, &snapshot->player, &globals.camera, &globals.drawingFlags, alpha);
+	if (snapshot->particles.spawn) {
+		renderParticles(&globals.particles, &snapshot->particles, &globals.camera, &globals.drawingFlags, alpha);
 	}
-}
 
-static bool checkEnemiesCollision()
-{
-	bool isCollided = false;
-	float distance;
-	float enemyRadius = globals.level.road.enemies->size.x * 1.41421356; // sqrt(2) = 1.41421356;
-	float overlap = (globals.player.size + enemyRadius) * (globals.player.size + enemyRadius);
-
-	Vec3f frog = globals.player.pos;
-	Vec3f enemy;
-
-	Entity * enemies = globals.level.road.enemies;
-
-	for (size_t i = 0; i < globals.level.road.numLanes; ++i) {
-		enemy = enemies->pos;
-		distance = (frog.x - enemy.x) * (frog.x - enemy.x) + 
-					(frog.y - enemy.y) * (frog.y - enemy.y) +
-					(frog.z - enemy.z) * (frog.z - enemy.z);
-		if (distance < overlap) {
-			isCollided = true;
-			break;
-			
-		}
-		enemies++;
-	}
-	return isCollided;
-}
+	// the sky has its own layer after the opaque one, so the depth test can reject everything hidden behind the level
+	renderSkybox(&globals.skybox, &globals.camera, &globals.drawingFlags);
+	flushRenderQueue();
 
-static bool checkLogsCollision()
-{
-	Vec3f frog = globals.player.pos;
-	Vec3f log;
-
-	bool isCollided = false;
-
-	Entity * logs = globals.level.river.logs;
-	float logLength = logs->size.z;
-	float logHeight = logs->size.y;
-	for (size_t i = 0; i < globals.level.river.numLanes; ++i) {
-		log = logs->pos;
-		Vec3f minPoint = {log.x - logLength / 2.0, 0.0, log.z - logHeight};
-		Vec3f maxPoint = {log.x + logLength / 2.0, 0.0, log.z + logHeight};
-
-		if (frog.x >= minPoint.x && frog.x <= maxPoint.x
-				&& frog.y <= logHeight
-				&& frog.z >= minPoint.z && frog.z <= maxPoint.z) {
-			attachFrogOnLog(*logs);
-			isCollided = true;
-			break;
-		}
-		logs++;
-		}
-	return isCollided;
-}
+	// all of the normals, axes and other debug lines from this frame go out in one draw
+	flushDebugLines();
 
-static void checkOutBoundary()
-{
-	Vec3f * frog = &globals.player.pos;
-	float posBoundary = globals.level.width / 2;
-	float negBoundary = -globals.level.width / 2;
-
-	if (frog->x < negBoundary) {
-		frog->x = negBoundary;
-	} else if (frog->x > posBoundary) {
-		frog->x = posBoundary;
-	}
+	renderOSD(snapshot);
 
-	if (frog->z < negBoundary) {
-		frog->z = negBoundary;
-	} else if (frog->z > posBoundary) {
-		frog->z = posBoundary;
-	}
+	endStreamFrame();
+	recordTiming(renderTiming, getClockTime() - start);
+	glutSwapBuffers();
+	markPresent(getClockTime());
 }
 
-
 static void update()
 {
-	static int tLast = -1;
-	
-	if (tLast < 0)
-		tLast = glutGet(GLUT_ELAPSED_TIME);
-
-	int t = glutGet(GLUT_ELAPSED_TIME);
-	int dtMs = t - tLast;
-	float dt = (float)dtMs / 1000.0f;
-	tLast = t;
-
-	bool enemyCollided = false;
-	bool logCollided = false;
-
-	if (globals.lives == 0) {
-		globals.halt = true;
+	// upload any textures the workers have finished decoding
+	finishJobs();
+
+	/* Frame timing stats, only worked out every frameRateInterval so the OSD stays readable */
+	double now = getClockTime();
+	double dt = now - globals.lastFrameRateT;
+	if (dt > globals.frameRateInterval) {
+		getTimingStats(globals.timings);
+		globals.lastFrameRateT = now;
 	}
 
-	if (!globals.halt) {
-		updatePlayer(&globals.player, dt, &globals.controls, t / 1000.0f);
-		updateLevel(&globals.level, dt);
-
-		enemyCollided = checkEnemiesCollision();
-		updateParticles(&globals.particles, enemyCollided, globals.player.pos, dt);
-		if (enemyCollided) {
-			globals.lives--;
-			resetGame();
-		}
-			
-		logCollided = checkLogsCollision();
-		if (!logCollided) { // when the log that frog is attached on disappears, onLog -> false
-			globals.player.onLog = false;
-			if (!globals.player.jump) {
-				globals.player.pos.y = 0.0; // frog falls into river when the log disappears
-			}
-		}
-		checkInRiver();
-
-		checkCrossRiver();
-		checkOutBoundary();
-		globals.camera.pos = globals.player.pos;
-	};
-
-	/* Frame rate */
-	dt = t / 1000.0f - globals.lastFrameRateT;
-	if (dt > globals.frameRateInterval) { // after frameRateInterval, calculate frameRate again
-		globals.frameRate = globals.frames / dt;
-		globals.lastFrameRateT = t / 1000.0f;
-		globals.frames = 0;
+	// nothing moves while time is stopped, so once input and loading have settled stop drawing until something happens
+	if (!globals.animating && !jobsPending() && now - globals.lastInputT > WAKE_TIME) {
+		globals.sleeping = true;
+		glutIdleFunc(NULL);
+		return;
 	}
 
+	waitForFrame();
 	glutPostRedisplay();
 }
 
@@ -385,11 +353,7 @@ static void keyDown(unsigned char key, int x, int y)
 			exit(EXIT_SUCCESS);
 			break;
 		case 'h':
-			globals.halt = !globals.halt;
-			if (globals.halt)
-				printf("Stopping time\n");
-			else
-				printf("Resuming time\n");
+			sendInput(&globals.keys, haltInput, 0, true, 0, 0);
 			break;
 		case 'l':
 			globals.drawingFlags.lighting = !globals.drawingFlags.lighting;
@@ -410,31 +374,30 @@ static void keyDown(unsigned char key, int x, int y)
 		case 'p':
 			globals.drawingFlags.wireframe = !globals.drawingFlags.wireframe;
 			if (globals.drawingFlags.wireframe) {
-				glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+				setPolygonMode(GL_LINE);
 				printf("Using wireframe rendering\n");
 			}
 			else {
-				glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+				setPolygonMode(GL_FILL);
 				printf("Using filled rendering\n");
 			}
 			break;
 		case '+':
 		case '=':
 			globals.drawingFlags.segments = clamp(globals.drawingFlags.segments * 2, 8, 1024);
-			generateLevelGeometry(&globals.level, globals.drawingFlags.segments);
-			printf("Tesselation: %zu\n", globals.drawingFlags.segments);
+			printf("Tesselation bias: %zu\n", globals.drawingFlags.segments);
 			break;
 		case '-':
 			globals.drawingFlags.segments = clamp(globals.drawingFlags.segments / 2, 8, 1024);
-			generateLevelGeometry(&globals.level, globals.drawingFlags.segments);
-			printf("Tesselation: %zu\n", globals.drawingFlags.segments);
+			printf("Tesselation bias: %zu\n", globals.drawingFlags.segments);
 			break;
 		default:
-			updateKeyChar(key, true); // player controls are updated here and processed on each frame
+			updateKeyChar(key, true); // player controls are queued here and picked up by the simulation's next step
 			break;
 	}
 
-	glutPostRedisplay();
+	// the drawing flags change what's on screen even while time is stopped
+	wakeUp();
 }
 
 static void keyUp(unsigned char key, int x, int y)
@@ -456,8 +419,6 @@ static void specialKeyDown(int key, int x, int y)
 		updateKeyInt(key, true);
 		break;
 	}
-
-	glutPostRedisplay();
 }
 
 static void specialKeyUp(int key, int x, int y)
@@ -468,46 +429,10 @@ static void specialKeyUp(int key, int x, int y)
 	updateKeyInt(key, false);
 }
 
-static void mouseMotion(int x, int y) {
-	int dX = x - globals.camera.lastX;
-	int dY = y - globals.camera.lastY;
-
-	if (globals.controls.lmb) {
-		globals.camera.xRot += dX * 0.1;
-		globals.camera.yRot += dY * 0.1;
-		globals.camera.yRot = clamp(globals.camera.yRot, 0, 90);
-	}
-	
-	if (globals.controls.rmb) {
-		globals.camera.zoom += dY * 0.01;
-		globals.camera.zoom = max(globals.camera.zoom, 0.5);
-	}
-
-	globals.camera.lastX = x;
-	globals.camera.lastY = y;
-
-	glutPostRedisplay();
-}
-
-static void mouseButton(int button, int state, int x, int y) {
-	if (state == GLUT_DOWN) {
-		globals.camera.lastX = x;
-		globals.camera.lastY = y;
-	}
-
-	if (button == GLUT_LEFT_BUTTON) {
-		globals.controls.lmb = state == GLUT_DOWN;
-	}
-	else if (button == GLUT_RIGHT_BUTTON) {
-		globals.controls.rmb = state == GLUT_DOWN;
-	}
-
-	glutPostRedisplay();
-}
-
-static void init() {
-	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-	glEnable(GL_DEPTH_TEST);
+static void init(const char* exePath, bool shaders, float tickRate, float frameRate, int vsync, const char* timingsPath) {
+	invalidateGLState();
+	setPolygonMode(GL_FILL);
+	setEnabled(GL_DEPTH_TEST, true);
 	glEnable(GL_LIGHT0);
 	glEnable(GL_NORMALIZE);
 
@@ -516,21 +441,39 @@ static void init() {
 	globals.drawingFlags.textures = true;
 	globals.drawingFlags.lighting = true;
 
-	resetGame();
+	initJobs();
+	initStream(4 << 20);
+	openAssets(exePath);
+	openBakedTextures("res/textures.bin");
+	if (shaders)
+		initShaders();
+	initPlayer(&globals.player);
+	initLevel(&globals.level);
+	initCamera(&globals.camera);
 	initSkybox(&globals.skybox);
 	globals.camera.width = 800;
 	globals.camera.height = 600;
 	
-	globals.score = 0;
-	globals.lives = 5;
-	
-	globals.halt = false;
-	globals.frames = 0;
-	globals.frameRate = 0.0;
+	globals.resets = 0;
+	globals.batches = 0;
+	globals.timingsPath = timingsPath;
 	globals.frameRateInterval = 0.2;
-	globals.lastFrameRateT = 0.0;
+	initTiming();
+	globals.lastFrameRateT = getClockTime();
+	globals.lastInputT = globals.lastFrameRateT;
+	globals.sleeping = false;
+	globals.animating = true;
+	initPacer(frameRate);
+	if (vsync >= 0 && !setVsync(vsync))
+		printf("Can't change vsync on this driver\n");
 
 	initParticles(&globals.particles, &globals.drawingFlags);
+	initText(&globals.osd);
+	initInputQueue(&globals.keys);
+	initInputQueue(&globals.mouse);
+
+	// from here on the game logic runs on its own thread and we only draw what it publishes
+	startSim(&globals.player, &globals.level, &globals.particles, &globals.keys, tickRate);
 }
 
 int main(int argc, char **argv)
@@ -550,7 +493,31 @@ int main(int argc, char **argv)
 	glutMouseFunc(mouseButton);
 	glutReshapeFunc(reshape);
 
-	init();
+	// the shader pipeline is opt in, with -shaders or FROG_SHADERS=1, -tick sets the simulation rate,
+	// -fps caps the frame rate (0 for no cap), -vsync or -novsync override the driver's vsync setting
+	// and -timings says where the frame timings are written on exit
+	const char* env = getenv("FROG_SHADERS");
+	bool shaders = env && strcmp(env, "0") != 0;
+	float tickRate = defaultTickRate;
+	float frameRate = defaultFrameRate;
+	int vsync = -1;
+	const char* timingsPath = "frametimes.csv";
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "-shaders") == 0)
+			shaders = true;
+		else if (strcmp(argv[i], "-tick") == 0 && i + 1 < argc)
+			tickRate = clamp(atof(argv[++i]), 1.0, 1000.0);
+		else if (strcmp(argv[i], "-fps") == 0 && i + 1 < argc)
+			frameRate = clamp(atof(argv[++i]), 0.0, 1000.0);
+		else if (strcmp(argv[i], "-vsync") == 0)
+			vsync = 1;
+		else if (strcmp(argv[i], "-novsync") == 0)
+			vsync = 0;
+		else if (strcmp(argv[i], "-timings") == 0 && i + 1 < argc)
+			timingsPath = argv[++i];
+	}
+
+	init(argv[0], shaders, tickRate, frameRate, vsync, timingsPath);
 
 	glutMainLoop();
 
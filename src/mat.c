@@ -0,0 +1,108 @@
+#include "mat.h"
+#include "util.h"
+
+/*
+ * Mat4f operations
+ */
+
+Mat4f identityMat4f() {
+	Mat4f r = { {
+		1, 0, 0, 0,
+		0, 1, 0, 0,
+		0, 0, 1, 0,
+		0, 0, 0, 1,
+	} };
+	return r;
+}
+
+Mat4f mulMat4f(Mat4f a, Mat4f b) {
+	Mat4f r;
+	for (int col = 0; col < 4; ++col) {
+		for (int row = 0; row < 4; ++row) {
+			r.m[col * 4 + row] = a.m[0 * 4 + row] * b.m[col * 4 + 0] +
+								a.m[1 * 4 + row] * b.m[col * 4 + 1] +
+								a.m[2 * 4 + row] * b.m[col * 4 + 2] +
+								a.m[3 * 4 + row] * b.m[col * 4 + 3];
+		}
+	}
+	return r;
+}
+
+Mat4f translateMat4f(Mat4f m, float x, float y, float z) {
+	for (int row = 0; row < 4; ++row) {
+		m.m[12 + row] += m.m[row] * x + m.m[4 + row] * y + m.m[8 + row] * z;
+	}
+	return m;
+}
+
+/*
+ * Rotate by angle degrees around the axis (x, y, z), as in glRotatef
+ */
+Mat4f rotateMat4f(Mat4f m, float angle, float x, float y, float z) {
+	Vec3f axis = normaliseVec3f((Vec3f) { x, y, z });
+	float rad = angle * M_PI / 180.0;
+	float c = cosf(rad);
+	float s = sinf(rad);
+	float t = 1.0 - c;
+
+	Mat4f r = identityMat4f();
+	r.m[0] = t * axis.x * axis.x + c;
+	r.m[1] = t * axis.x * axis.y + s * axis.z;
+	r.m[2] = t * axis.x * axis.z - s * axis.y;
+	r.m[4] = t * axis.x * axis.y - s * axis.z;
+	r.m[5] = t * axis.y * axis.y + c;
+	r.m[6] = t * axis.y * axis.z + s * axis.x;
+	r.m[8] = t * axis.x * axis.z + s * axis.y;
+	r.m[9] = t * axis.y * axis.z - s * axis.x;
+	r.m[10] = t * axis.z * axis.z + c;
+
+	return mulMat4f(m, r);
+}
+
+Mat4f scaleMat4f(Mat4f m, float x, float y, float z) {
+	for (int row = 0; row < 4; ++row) {
+		m.m[row] *= x;
+		m.m[4 + row] *= y;
+		m.m[8 + row] *= z;
+	}
+	return m;
+}
+
+/*
+ * The same projection matrix as gluPerspective, fovY is in degrees
+ */
+Mat4f perspectiveMat4f(float fovY, float aspect, float near, float far) {
+	float f = 1.0 / tanf(fovY * M_PI / 360.0);
+	Mat4f r = { { 0 } };
+	r.m[0] = f / aspect;
+	r.m[5] = f;
+	r.m[10] = (far + near) / (near - far);
+	r.m[11] = -1;
+	r.m[14] = 2.0 * far * near / (near - far);
+	return r;
+}
+
+Vec3f transformPointMat4f(Mat4f m, Vec3f p) {
+	Vec3f r;
+	r.x = m.m[0] * p.x + m.m[4] * p.y + m.m[8] * p.z + m.m[12];
+	r.y = m.m[1] * p.x + m.m[5] * p.y + m.m[9] * p.z + m.m[13];
+	r.z = m.m[2] * p.x + m.m[6] * p.y + m.m[10] * p.z + m.m[14];
+	return r;
+}
+
+/*
+ * Transform a normal by the inverse transpose of the upper 3x3 of m, so non-uniform scales don't skew it.
+ * The cofactor matrix is the inverse transpose multiplied by the determinant, which goes away when we normalise
+ */
+Vec3f transformNormalMat4f(Mat4f m, Vec3f n) {
+	const float* a = m.m;
+	Vec3f c0 = crossVec3f((Vec3f) { a[4], a[5], a[6] }, (Vec3f) { a[8], a[9], a[10] });
+	Vec3f c1 = crossVec3f((Vec3f) { a[8], a[9], a[10] }, (Vec3f) { a[0], a[1], a[2] });
+	Vec3f c2 = crossVec3f((Vec3f) { a[0], a[1], a[2] }, (Vec3f) { a[4], a[5], a[6] });
+
+	Vec3f r;
+	r.x = c0.x * n.x + c1.x * n.y + c2.x * n.z;
+	r.y = c0.y * n.x + c1.y * n.y + c2.y * n.z;
+	r.z = c0.z * n.x + c1.z * n.y + c2.z * n.z;
+	return normaliseVec3f(r);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "vec.h"
+
+// 4x4 matrix stored in column-major order, the same layout GL uses so it can be passed straight to glLoadMatrixf
+typedef struct {
+	float m[16];
+} Mat4f;
+
+Mat4f identityMat4f();
+Mat4f mulMat4f(Mat4f a, Mat4f b);
+
+// these post-multiply m, the same way glTranslatef, glRotatef and glScalef do to the current matrix
+Mat4f translateMat4f(Mat4f m, float x, float y, float z);
+Mat4f rotateMat4f(Mat4f m, float angle, float x, float y, float z);
+Mat4f scaleMat4f(Mat4f m, float x, float y, float z);
+
+Mat4f perspectiveMat4f(float fovY, float aspect, float near, float far);
+
+Vec3f transformPointMat4f(Mat4f m, Vec3f p);
+Vec3f transformNormalMat4f(Mat4f m, Vec3f n);
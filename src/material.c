@@ -1,12 +1,16 @@
 #include "material.h"
 
 #include "gl.h"
+#include "glstate.h"
 
 /*
- * Apply a material for GL to use for lighting up your mesh
+ * Apply a material for GL to use for lighting up your mesh, unless it's the one already in use
  */
 void applyMaterial(Material* material)
 {
+	if (!cacheMaterial(material))
+		return;
+
 	glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, (GLfloat*) &material->ambient);
 	glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, (GLfloat*) &material->diffuse);
 	glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, (GLfloat*) &material->specular);
@@ -1,7 +1,11 @@
 #include "mesh.h"
 #include "gl.h"
+#include "debug.h"
+#include "glstate.h"
+#include "stream.h"
 
 #include <string.h>
+#include <stddef.h>
 
 /*
  * I got a little lazy, so these verts are stored in global memory and just copied to the heap in the createCube function
@@ -53,9 +57,47 @@ Mesh* createMesh(size_t numVerts, size_t numIndices) {
 	mesh->numIndices = numIndices;
 	mesh->verts = (Vertex*) calloc(numVerts, sizeof(Vertex));
 	mesh->indices = (unsigned int*) calloc(numIndices, sizeof(int));
+	glGenBuffers(1, &mesh->vbo);
+	glGenBuffers(1, &mesh->ibo);
 	return mesh;
 }
 
+/*
+ * Copy the vertices and indices of a mesh into its buffer objects.
+ * Call this once the mesh has been filled in, after that renderMesh only has to bind the buffers
+ */
+void uploadMesh(Mesh* mesh) {
+	Vec3f lo = mesh->verts[0].pos;
+	Vec3f hi = lo;
+	for (size_t i = 1; i < mesh->numVerts; ++i) {
+		Vec3f p = mesh->verts[i].pos;
+		lo = (Vec3f) { min(lo.x, p.x), min(lo.y, p.y), min(lo.z, p.z) };
+		hi = (Vec3f) { max(hi.x, p.x), max(hi.y, p.y), max(hi.z, p.z) };
+	}
+	mesh->center = mulVec3f(addVec3f(lo, hi), 0.5);
+	mesh->extents = (Vec3f) { hi.x - mesh->center.x, hi.y - mesh->center.y, hi.z - mesh->center.z };
+	mesh->radius = magVec3f(mesh->extents);
+
+	glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+	glBufferData(GL_ARRAY_BUFFER, mesh->numVerts * sizeof(Vertex), mesh->verts, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh->numIndices * sizeof(unsigned int), mesh->indices, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+/*
+ * Drop the CPU-side copy of a mesh that has already been uploaded.
+ * The mesh can still be drawn, but the normals can't be drawn for it anymore
+ */
+void releaseMeshData(Mesh* mesh) {
+	free(mesh->verts);
+	free(mesh->indices);
+	mesh->verts = NULL;
+	mesh->indices = NULL;
+}
+
 /*
  * Free up the memory used by a mesh
  */
@@ -65,38 +107,49 @@ void destroyMesh(Mesh* mesh) {
 			free(mesh->indices);
 		if (mesh->verts)
 			free(mesh->verts);
+		glDeleteBuffers(1, &mesh->vbo);
+		glDeleteBuffers(1, &mesh->ibo);
 		free(mesh);
 	}
 }
 
+/*
+ * The radius of a sphere around the mesh once it has been scaled, taken from the corners of its bounding box
+ */
+float getMeshRadius(Mesh* mesh, Vec3f scale) {
+	return magVec3f((Vec3f) { mesh->extents.x * scale.x, mesh->extents.y * scale.y, mesh->extents.z * scale.z });
+}
+
 /*
  * Draw a mesh.
  * Will also draw the debug lines toggled in the provided flags
  */
 void renderMesh(Mesh* mesh, DrawingFlags* flags) {
-	glPushAttrib(GL_CURRENT_BIT | GL_ENABLE_BIT);
-
-	if (flags->lighting)
-		glEnable(GL_LIGHTING);
+	glPushAttrib(GL_CURRENT_BIT);
 
-	if (flags->textures)
-		glEnable(GL_TEXTURE_2D);
+	setEnabled(GL_LIGHTING, flags->lighting);
+	setEnabled(GL_TEXTURE_2D, flags->textures);
 
-	// you can use vertex arrays to send the vertices to the GPU all at once
-	// this way using glVertexPointer is still deprecated, but it's closer to how you do this in modern GL
-	// if you want you could try using VBOs, otherwise you'll learn how later in Realtime Rendering
+	// the vertices were uploaded to VBOs when the mesh was created, so the pointers here are offsets into the
+	// bound buffers and nothing has to be copied to the GPU when we draw
 #if 1
 	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
 
+	glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ibo);
+
 	glEnableClientState(GL_VERTEX_ARRAY);
 	glEnableClientState(GL_NORMAL_ARRAY);
 	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 
-	glVertexPointer(3, GL_FLOAT, sizeof(Vertex), mesh->verts);
-	glNormalPointer(GL_FLOAT, sizeof(Vertex), &mesh->verts[0].normal);
-	glTexCoordPointer(2, GL_FLOAT, sizeof(Vertex), &mesh->verts[0].tc);
+	glVertexPointer(3, GL_FLOAT, sizeof(Vertex), (void*) offsetof(Vertex, pos));
+	glNormalPointer(GL_FLOAT, sizeof(Vertex), (void*) offsetof(Vertex, normal));
+	glTexCoordPointer(2, GL_FLOAT, sizeof(Vertex), (void*) offsetof(Vertex, tc));
+
+	glDrawElements(GL_TRIANGLES, mesh->numIndices, GL_UNSIGNED_INT, 0);
 
-	glDrawElements(GL_TRIANGLES, mesh->numIndices, GL_UNSIGNED_INT, mesh->indices);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
 	glPopClientAttrib();
 #endif
@@ -115,18 +168,105 @@ void renderMesh(Mesh* mesh, DrawingFlags* flags) {
 
 	glPopAttrib();
 
+	if (flags->axes || flags->normals)
+		setDebugTransform(NULL);
+
 	if (flags->axes) {
 		drawAxes();
 	}
 
-	if (flags->normals) {
-		glBegin(GL_LINES);
+	if (flags->normals && mesh->verts) {
 		for (size_t i = 0; i < mesh->numVerts; ++i) {
 			Vertex v = mesh->verts[i];
 			Vec3f n = addVec3f(mulVec3f(v.normal, 0.1), v.pos);
 			drawLine(YELLOW, v.pos, n);
 		}
-		glEnd();
+	}
+}
+
+/*
+ * Draw many copies of a mesh, each with its own model transform, in a single draw call.
+ * The fixed function pipeline has no way to fetch a matrix per instance, so the copies are transformed on the CPU,
+ * straight into this frame's stream. This needs the CPU-side copy of the mesh, so don't release it for meshes drawn here
+ */
+void renderMeshInstanced(Mesh* mesh, const Mat4f* transforms, size_t numInstances, DrawingFlags* flags) {
+	if (numInstances == 0 || !mesh->verts)
+		return;
+
+	size_t numVerts = mesh->numVerts * numInstances;
+	size_t numIndices = mesh->numIndices * numInstances;
+	StreamRange verts = allocStream(numVerts * sizeof(Vertex));
+	StreamRange indices = allocStream(numIndices * sizeof(unsigned int));
+
+	// the stream may be write combined memory, so only ever write to it, in order
+	Vertex* v = (Vertex*) verts.data;
+	unsigned int* index = (unsigned int*) indices.data;
+	for (size_t i = 0; i < numInstances; ++i) {
+		unsigned int base = i * mesh->numVerts;
+		for (size_t j = 0; j < mesh->numVerts; ++j) {
+			v->pos = transformPointMat4f(transforms[i], mesh->verts[j].pos);
+			v->normal = transformNormalMat4f(transforms[i], mesh->verts[j].normal);
+			v->tc = mesh->verts[j].tc;
+			++v;
+		}
+		for (size_t j = 0; j < mesh->numIndices; ++j) {
+			*index++ = mesh->indices[j] + base;
+		}
+	}
+	commitStream(&verts, numVerts * sizeof(Vertex));
+	commitStream(&indices, numIndices * sizeof(unsigned int));
+
+	glPushAttrib(GL_CURRENT_BIT);
+
+	setEnabled(GL_LIGHTING, flags->lighting);
+	setEnabled(GL_TEXTURE_2D, flags->textures);
+
+	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+
+	glBindBuffer(GL_ARRAY_BUFFER, verts.buffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices.buffer);
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+
+	glVertexPointer(3, GL_FLOAT, sizeof(Vertex), (void*) (verts.offset + offsetof(Vertex, pos)));
+	glNormalPointer(GL_FLOAT, sizeof(Vertex), (void*) (verts.offset + offsetof(Vertex, normal)));
+	glTexCoordPointer(2, GL_FLOAT, sizeof(Vertex), (void*) (verts.offset + offsetof(Vertex, tc)));
+
+	glDrawElements(GL_TRIANGLES, numIndices, GL_UNSIGNED_INT, (void*) indices.offset);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	glPopClientAttrib();
+	glPopAttrib();
+
+	renderMeshDebug(mesh, transforms, numInstances, flags);
+}
+
+/*
+ * Queue the axes and normals of each copy of an instanced mesh, if the flags ask for them.
+ * The normals need the CPU-side copy of the mesh
+ */
+void renderMeshDebug(Mesh* mesh, const Mat4f* transforms, size_t numInstances, DrawingFlags* flags) {
+	if (flags->axes) {
+		for (size_t i = 0; i < numInstances; ++i) {
+			setDebugTransform(&transforms[i]);
+			drawAxes();
+		}
+	}
+
+	if (flags->normals && mesh->verts) {
+		setDebugTransform(NULL);
+		for (size_t i = 0; i < numInstances; ++i) {
+			for (size_t j = 0; j < mesh->numVerts; ++j) {
+				Vertex v = mesh->verts[j];
+				Vec3f p = transformPointMat4f(transforms[i], v.pos);
+				Vec3f n = transformPointMat4f(transforms[i], addVec3f(mulVec3f(v.normal, 0.1), v.pos));
+				drawLine(YELLOW, p, n);
+			}
+		}
 	}
 }
 
@@ -139,6 +279,7 @@ Mesh* createCube() {
 	Mesh* mesh = createMesh(24, 36);
 	memcpy(mesh->verts, cubeVerts, 24 * sizeof(Vertex));
 	memcpy(mesh->indices, cubeIndices, 36 * sizeof(unsigned int));
+	uploadMesh(mesh);
 	return mesh;
 }
 
@@ -175,6 +316,7 @@ Mesh* createPlane(float width, float height, size_t rows, size_t cols) {
 		}
 	}
 
+	uploadMesh(mesh);
 	return mesh;
 }
 
@@ -216,6 +358,7 @@ Mesh* createSphere(size_t stacks, size_t slices) {
 		}
 	}
 
+	uploadMesh(mesh);
 	return mesh;
 }
 
@@ -296,46 +439,6 @@ Mesh* createCylinder(size_t stacks, size_t slices, float radius) {
 		}
 	}
 
+	uploadMesh(mesh);
 	return mesh;
 }
-
-/*
- * Draw a line from a to b, assumes you have already called glBegin and will call glEnd sometime after
- */
-void drawLine(Vec3f color, Vec3f a, Vec3f b) {
-	glPushAttrib(GL_CURRENT_BIT);
-	submitColor(color);
-	submitVertex(a);
-	submitVertex(b);
-	glPopAttrib();
-}
-
-/*
- * Draw a parabola for the specified initial velocity and gravity
- */
-void drawParabola(Vec3f color, Vec3f vel, float g, DrawingFlags* flags) {
-	float tof = (2.0 * vel.y) / g;
-	float step = tof / (float) flags->segments;
-
-	glBegin(GL_LINES);
-
-	// this loop doesn't draw the last tangent, but usually it won't be visible through the floor so it's not a huge deal
-	for (size_t i = 0; i < flags->segments; ++i) {
-		float t0 = i * step;
-		float t1 = (i + 1) * step;
-
-		Vec3f a = { t0 * vel.x, t0 * vel.y - 0.5 * g * t0 * t0, t0 * vel.z };
-		Vec3f b = { t1 * vel.x, t1 * vel.y - 0.5 * g * t1 * t1, t1 * vel.z };
-		
-		drawLine(color, a, b);
-
-		if (flags->normals) {
-			Vec3f t = { vel.x, vel.y - g * t0, vel.z };
-			t = mulVec3f(normaliseVec3f(t), 0.05);
-			t = addVec3f(a, t);
-			drawLine(CYAN, a, t);
-		}
-	}
-
-	glEnd();
-}
@@ -1,9 +1,11 @@
 #pragma once
 
 #include "util.h"
+#include "mat.h"
 
 /*
  * Flags used to specify debug lines, wireframe rendering, tesselation, etc
+ * segments is the tessellation of the jump parabola, and the quality bias used to pick each shape's level of detail
  */
 typedef struct {
 	bool normals, wireframe, lighting, textures, axes;
@@ -20,21 +22,29 @@ typedef struct {
 
 /*
  * An indexed mesh which can be used for instanced rendering
+ * The vertices and indices live on the GPU in vbo and ibo once uploaded, verts and indices are only a CPU-side copy
+ * and may be NULL if they were released after the upload.
+ * The bounds (an axis aligned box around center with half size extents, and a sphere with the same center) are worked out on upload
  */
 typedef struct {
 	Vertex* verts;
 	unsigned int* indices;
 	size_t numVerts, numIndices;
+	unsigned int vbo, ibo;
+	Vec3f center, extents;
+	float radius;
 } Mesh;
 
 Mesh* createMesh(size_t numVerts, size_t numIndices);
+void uploadMesh(Mesh* mesh);
+void releaseMeshData(Mesh* mesh);
 void destroyMesh(Mesh* mesh);
+float getMeshRadius(Mesh* mesh, Vec3f scale);
 void renderMesh(Mesh* mesh, DrawingFlags* flags);
+void renderMeshInstanced(Mesh* mesh, const Mat4f* transforms, size_t numInstances, DrawingFlags* flags);
+void renderMeshDebug(Mesh* mesh, const Mat4f* transforms, size_t numInstances, DrawingFlags* flags);
 
 Mesh* createCube();
 Mesh* createPlane(float width, float height, size_t rows, size_t cols);
 Mesh* createSphere(size_t segments, size_t slices);
 Mesh* createCylinder(size_t segments, size_t slices, float radius);
-
-void drawLine(Vec3f color, Vec3f a, Vec3f b);
-void drawParabola(Vec3f color, Vec3f vel, float g, DrawingFlags* flags);
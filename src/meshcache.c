@@ -0,0 +1,116 @@
+#include "meshcache.h"
+
+enum { cubeShape, planeShape, cylinderShape, n_shapes };
+
+/*
+ * Everything needed to tell two procedural meshes apart
+ */
+typedef struct {
+	int shape;
+	float width, height, radius;
+	size_t rows, cols;
+} MeshKey;
+
+typedef struct {
+	MeshKey key;
+	Mesh* mesh;
+	int refs;
+} MeshCacheEntry;
+
+static struct {
+	MeshCacheEntry* entries;
+	size_t numEntries, maxEntries;
+} meshCache;
+
+static bool sameMeshKey(MeshKey a, MeshKey b) {
+	return a.shape == b.shape && a.width == b.width && a.height == b.height && a.radius == b.radius
+		&& a.rows == b.rows && a.cols == b.cols;
+}
+
+/*
+ * Return the cached mesh for a key, building it first if it isn't in the cache yet
+ */
+static Mesh* acquireMesh(MeshKey key) {
+	for (size_t i = 0; i < meshCache.numEntries; ++i) {
+		MeshCacheEntry* entry = &meshCache.entries[i];
+		if (sameMeshKey(entry->key, key)) {
+			entry->refs++;
+			return entry->mesh;
+		}
+	}
+
+	Mesh* mesh = NULL;
+	switch (key.shape) {
+		case cubeShape:
+			mesh = createCube();
+			break;
+		case planeShape:
+			mesh = createPlane(key.width, key.height, key.rows, key.cols);
+			break;
+		case cylinderShape:
+			mesh = createCylinder(key.rows, key.cols, key.radius);
+			break;
+		default:
+			return NULL;
+	}
+
+	if (meshCache.numEntries == meshCache.maxEntries) {
+		meshCache.maxEntries = max(meshCache.maxEntries * 2, 16);
+		meshCache.entries = (MeshCacheEntry*) realloc(meshCache.entries, meshCache.maxEntries * sizeof(MeshCacheEntry));
+	}
+	meshCache.entries[meshCache.numEntries++] = (MeshCacheEntry) { key, mesh, 1 };
+	return mesh;
+}
+
+Mesh* acquireCube() {
+	return acquireMesh((MeshKey) { .shape = cubeShape });
+}
+
+Mesh* acquirePlane(float width, float height, size_t rows, size_t cols) {
+	return acquireMesh((MeshKey) { .shape = planeShape, .width = width, .height = height, .rows = rows, .cols = cols });
+}
+
+Mesh* acquireCylinder(size_t stacks, size_t slices, float radius) {
+	return acquireMesh((MeshKey) { .shape = cylinderShape, .radius = radius, .rows = stacks, .cols = slices });
+}
+
+/*
+ * Stop using a mesh from the cache. It isn't destroyed until the cache is purged
+ */
+void releaseMesh(Mesh* mesh) {
+	if (!mesh)
+		return;
+
+	for (size_t i = 0; i < meshCache.numEntries; ++i) {
+		if (meshCache.entries[i].mesh == mesh) {
+			meshCache.entries[i].refs--;
+			return;
+		}
+	}
+}
+
+/*
+ * Destroy every mesh that nobody is using any more
+ */
+void purgeMeshCache() {
+	size_t kept = 0;
+	for (size_t i = 0; i < meshCache.numEntries; ++i) {
+		MeshCacheEntry entry = meshCache.entries[i];
+		if (entry.refs > 0)
+			meshCache.entries[kept++] = entry;
+		else
+			destroyMesh(entry.mesh);
+	}
+	meshCache.numEntries = kept;
+}
+
+/*
+ * Destroy every mesh in the cache, whether it is still being used or not
+ */
+void destroyMeshCache() {
+	for (size_t i = 0; i < meshCache.numEntries; ++i)
+		destroyMesh(meshCache.entries[i].mesh);
+	free(meshCache.entries);
+	meshCache.entries = NULL;
+	meshCache.numEntries = meshCache.maxEntries = 0;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "mesh.h"
+
+/*
+ * A cache of the procedural meshes, so everything asking for the same shape with the same parameters shares one Mesh.
+ * Each mesh counts its users, and meshes nobody is using any more stay in the cache until purgeMeshCache is called,
+ * so anything that is released and acquired again in between (like the level during a reset) isn't rebuilt
+ */
+Mesh* acquireCube();
+Mesh* acquirePlane(float width, float height, size_t rows, size_t cols);
+Mesh* acquireCylinder(size_t stacks, size_t slices, float radius);
+void releaseMesh(Mesh* mesh);
+
+void purgeMeshCache();
+void destroyMeshCache();
@@ -0,0 +1,100 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "pacer.h"
+#include "ticker.h"
+#include "gl.h"
+
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <string.h>
+
+#if __APPLE__
+#  include <OpenGL/OpenGL.h>
+#elif !_WIN32
+#  include <GL/glx.h>
+#endif
+
+static struct {
+	double interval;
+	double deadline;
+} pacer;
+
+void initPacer(float rate) {
+	pacer.interval = rate > 0 ? 1.0 / rate : 0.0;
+	resetPacer();
+}
+
+/*
+ * Start the schedule again from now, for after a pause where no frames were due
+ */
+void resetPacer() {
+	pacer.deadline = getClockTime();
+}
+
+/*
+ * Sleep until the next frame is due
+ */
+void waitForFrame() {
+	if (pacer.interval <= 0.0)
+		return;
+
+	pacer.deadline += pacer.interval;
+	double now = getClockTime();
+	if (pacer.deadline <= now) {
+		// already late, so go now and count the next frame from here
+		pacer.deadline = now;
+		return;
+	}
+
+	struct timespec ts;
+	ts.tv_sec = (time_t) pacer.deadline;
+	ts.tv_nsec = (long) ((pacer.deadline - floor(pacer.deadline)) * 1e9);
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+		;
+}
+
+#if !__APPLE__ && !_WIN32
+static bool hasGLXExtension(Display* display, const char* name) {
+	const char* extensions = glXQueryExtensionsString(display, DefaultScreen(display));
+	return extensions && strstr(extensions, name) != NULL;
+}
+#endif
+
+/*
+ * Ask the driver to sync buffer swaps to the display's refresh, or not to. Returns false if there's no way to ask
+ */
+bool setVsync(bool enabled) {
+	int interval = enabled ? 1 : 0;
+#if __APPLE__
+	GLint swapInterval = interval;
+	return CGLSetParameter(CGLGetCurrentContext(), kCGLCPSwapInterval, &swapInterval) == kCGLNoError;
+#elif _WIN32
+	typedef BOOL (WINAPI *SwapIntervalFunc)(int);
+	SwapIntervalFunc swapInterval = (SwapIntervalFunc) wglGetProcAddress("wglSwapIntervalEXT");
+	return swapInterval && swapInterval(interval);
+#else
+	Display* display = glXGetCurrentDisplay();
+	if (!display)
+		return false;
+
+	typedef void (*SwapIntervalEXTFunc)(Display*, GLXDrawable, int);
+	typedef int (*SwapIntervalFunc)(int);
+	if (hasGLXExtension(display, "GLX_EXT_swap_control")) {
+		SwapIntervalEXTFunc swapInterval = (SwapIntervalEXTFunc) glXGetProcAddressARB((const GLubyte*) "glXSwapIntervalEXT");
+		swapInterval(display, glXGetCurrentDrawable(), interval);
+		return true;
+	}
+
+	// the MESA and SGI versions only take an interval, and the SGI one can't turn vsync off
+	const char* name = NULL;
+	if (hasGLXExtension(display, "GLX_MESA_swap_control"))
+		name = "glXSwapIntervalMESA";
+	else if (enabled && hasGLXExtension(display, "GLX_SGI_swap_control"))
+		name = "glXSwapIntervalSGI";
+	if (!name)
+		return false;
+	SwapIntervalFunc swapInterval = (SwapIntervalFunc) glXGetProcAddressARB((const GLubyte*) name);
+	return swapInterval(interval) == 0;
+#endif
+}
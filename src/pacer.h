@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdbool.h>
+
+/*
+ * Paces frames to a target rate by sleeping until each one is due on the monotonic clock, instead of spinning.
+ * Deadlines are absolute, so time spent drawing comes out of the sleep rather than adding to it, and a frame that runs
+ * late starts the schedule again from now instead of rushing the next few out to catch up.
+ * A rate of 0 doesn't limit the frame rate at all. Vsync is separate and up to the driver, setVsync says if it took
+ */
+void initPacer(float rate);
+void resetPacer();
+void waitForFrame();
+
+bool setVsync(bool enabled);
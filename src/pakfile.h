@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * The layout of the asset archive written by tools/respack.c. The file is a PakHeader, then numEntries PakEntry
+ * records sorted by name, then the bytes of every file. Offsets are from the start of the archive and aligned to pakAlignment
+ */
+#define PAK_MAGIC 0x314b4150 // "PAK1"
+
+enum { maxPakName = 96, pakAlignment = 16 };
+
+typedef struct {
+	uint32_t magic;
+	uint32_t numEntries;
+} PakHeader;
+
+typedef struct {
+	char name[maxPakName];
+	uint32_t offset;
+	uint32_t size;
+} PakEntry;
@@ -1,4 +1,5 @@
 #include "particles.h"
+#include "renderqueue.h"
 #include "gl.h"
 
 #include <string.h>
@@ -37,6 +38,7 @@ static void resetParticles(Particles * particles, Vec3f playerPos) {
 	for (int i = 0; i < particles->num_particles; i++) {
 		particle = &particles->particles[i];
 		particle->pos = playerPos;
+		particle->prevPos = playerPos;
 		particle->initPos = playerPos;
 		particle->speed = getTRand(1.0, 5.0);
 		particle->initVel.x = getTRand(-1.0, 1.0);
@@ -48,19 +50,56 @@ static void resetParticles(Particles * particles, Vec3f playerPos) {
 	}
 }
 
+/*
+ * Make a small texture that shades a point sprite so it looks like a lit ball.
+ * Texels outside of the ball are transparent and get thrown away by the alpha test
+ */
+static unsigned int createSpriteTexture() {
+	enum { spriteSize = 32 };
+	unsigned char pixels[spriteSize * spriteSize * 4];
+	Vec3f light = normaliseVec3f((Vec3f) { 1, 1, 1 });
+
+	for (int i = 0; i < spriteSize; i++) {
+		for (int j = 0; j < spriteSize; j++) {
+			float x = (j + 0.5) / spriteSize * 2.0 - 1.0;
+			float y = (i + 0.5) / spriteSize * 2.0 - 1.0;
+			float d = x * x + y * y;
+			unsigned char * texel = &pixels[(i * spriteSize + j) * 4];
+
+			// treat the sprite as the front half of a sphere and light it like the rest of the scene
+			Vec3f n = { x, y, sqrtf(max(0.0, 1.0 - d)) };
+			float shade = 0.2 + 0.8 * max(0.0, dotVec3f(n, light));
+			texel[0] = texel[1] = texel[2] = (unsigned char) (shade * 255.0);
+			texel[3] = d <= 1.0 ? 255 : 0;
+		}
+	}
+
+	unsigned int id;
+	glPushAttrib(GL_TEXTURE_BIT);
+	glGenTextures(1, &id);
+	glBindTexture(GL_TEXTURE_2D, id);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, spriteSize, spriteSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	glPopAttrib();
+	return id;
+}
+
 void initParticles(Particles * particles, DrawingFlags * flags) {
+	UNUSED(flags);
+
 	particles->size = 0.05;
 	particles->g = 9.8;
 	particles->spawn = false;
 
-	particles->mesh = createSphere(flags->segments, flags->segments);
-	particles->material = (Material) { { 0.2, 0.2, 0.2, 0 }, { 1, 0, 0, 0 }, { 1, 1, 1, 0 }, 50 };
-	particles->num_particles = 100;
+	particles->num_particles = maxParticles;
 	particles->particles = (Particle*) malloc(sizeof(Particle) * particles->num_particles);
 	resetParticles(particles, (Vec3f) {0.0, -particles->size, 0.0});
 	for (int i = 0; i < particles->num_particles; i++) {
 		particles->particles[i].jump = false;
 	}
+
+	particles->spriteTexture = createSpriteTexture();
 }
 
 /*
@@ -68,13 +107,16 @@ void initParticles(Particles * particles, DrawingFlags * flags) {
  */
 void destroyParticles(Particles* particles) {
 	free(particles->particles);
-	destroyMesh(particles->mesh);
+	glDeleteTextures(1, &particles->spriteTexture);
 }
 
 /*
  * Update the particles's state for frametime dt.
  */
 void updateParticles(Particles* particles, bool isCollided, Vec3f playerPos, float dt) {
+	for (int i = 0; i < particles->num_particles; i++)
+		particles->particles[i].prevPos = particles->particles[i].pos;
+
 	if (isCollided) {
 		particles->spawn = true;
 		resetParticles(particles, playerPos);
@@ -85,42 +127,81 @@ void updateParticles(Particles* particles, bool isCollided, Vec3f playerPos, flo
 }
 
 /*
- * Draw the particles's mesh, as well as a parabola showing our jump arc and a visualization of our current velocity
+ * Draw the particles packed by renderParticles as point sprites with a single draw call.
+ * The sprites are scaled with distance so they stay the same size in the world as the particles
  */
-void renderParticles(Particles* particles, DrawingFlags* flags) {
-	Particle * particle;
-	glPushAttrib(GL_CURRENT_BIT | GL_LIGHTING_BIT);
+static void drawParticles(void* data) {
+	Particles* particles = (Particles*) data;
+
+	// a point of size s is drawn s / d pixels wide at eye distance d, so use how many pixels a particle covers at d = 1
+	float attenuation[] = { 0.0, 0.0, 1.0 };
+
+	glPushAttrib(GL_CURRENT_BIT | GL_ENABLE_BIT | GL_POINT_BIT | GL_TEXTURE_BIT | GL_COLOR_BUFFER_BIT);
+	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+
+	glPointSize(particles->pointSize);
+	glPointParameterfv(GL_POINT_DISTANCE_ATTENUATION, attenuation);
+	glDisable(GL_LIGHTING);
+	glEnable(GL_POINT_SPRITE);
+	glEnable(GL_ALPHA_TEST);
+	glAlphaFunc(GL_GREATER, 0.5);
+
+	// the shading is baked into the sprite, so the textures flag only decides whether we get a ball or a square
+	if (particles->textured) {
+		glEnable(GL_TEXTURE_2D);
+		glBindTexture(GL_TEXTURE_2D, particles->spriteTexture);
+		glTexEnvi(GL_POINT_SPRITE, GL_COORD_REPLACE, GL_TRUE);
+	} else {
+		glDisable(GL_TEXTURE_2D);
+	}
+	submitColor(RED);
 
-	// // draw the parabola from the starting point of the jump
-	// for (int i = 0; i < particles->num_particles; i++) {
-	// 	particle = &particles->particles[i];
-	// 	glPushMatrix();
-	// 	glTranslatef(particle->initPos.x, particle->initPos.y, particle->initPos.z);
-	// 	drawParabola(BLUE, particle->initVel, particles->g, flags);
-	// 	glPopMatrix();
-	// }
+	commitStream(&particles->positions, sizeof(Vec3f) * particles->numVisible);
+	glBindBuffer(GL_ARRAY_BUFFER, particles->positions.buffer);
 
-	for (int i = 0; i < particles->num_particles; i++) {
-		particle = &particles->particles[i];
-		glPushMatrix();
-			glTranslatef(particle->pos.x, particle->pos.y, particle->pos.z);
-
-			// draw the particles mesh at our current position
-			glPushMatrix();
-				glScalef(particles->size, particles->size, particles->size);
-				applyMaterial(&particles->material);
-				submitColor(RED);
-				if (particle->jump) {
-					renderMesh(particles->mesh, flags);
-				}
-			glPopMatrix();
-			
-			// // draw the visualization of the particles's velocity at particle current position
-			// glBegin(GL_LINES);
-			// drawLine(PURPLE, (Vec3f) { 0, 0, 0 }, mulVec3f(particle->vel, 0.1)); 
-			// glEnd();
-		glPopMatrix();
-	}
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, sizeof(Vec3f), (void*) particles->positions.offset);
+	glDrawArrays(GL_POINTS, 0, particles->numVisible);
 
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glPopClientAttrib();
 	glPopAttrib();
 }
+
+/*
+ * Copy out the particles for a snapshot
+ */
+void saveParticleState(Particles* particles, ParticleState* state) {
+	memcpy(state->particles, particles->particles, sizeof(Particle) * particles->num_particles);
+	state->spawn = particles->spawn;
+}
+
+/*
+ * Pack the live particles from a snapshot that the camera can see and submit them to the render queue as one item.
+ * Each one is drawn alpha of the way from where it was before the last step to where it is now
+ */
+void renderParticles(Particles* particles, const ParticleState* state, Camera* camera, DrawingFlags* flags, float alpha) {
+	// gather the visible ones first, so a frame where none of them are visible doesn't take up any of the stream
+	Vec3f visible[maxParticles];
+	Vec3f center = { 0, 0, 0 };
+	int numLive = 0;
+	for (int i = 0; i < particles->num_particles; i++) {
+		const Particle * particle = &state->particles[i];
+		Vec3f pos = lerpVec3f(particle->prevPos, particle->pos, alpha);
+		if (particle->jump && isSphereVisible(camera, pos, particles->size)) {
+			visible[numLive++] = pos;
+			center = addVec3f(center, pos);
+		}
+	}
+	if (numLive == 0)
+		return;
+
+	particles->positions = allocStream(sizeof(Vec3f) * numLive);
+	memcpy(particles->positions.data, visible, sizeof(Vec3f) * numLive);
+	particles->numVisible = numLive;
+	particles->pointSize = 2.0 * particles->size * camera->pixelsPerUnit;
+	particles->textured = flags->textures;
+	submitCustom(opaqueLayer, mulVec3f(center, 1.0f / numLive), drawParticles, particles);
+}
@@ -2,24 +2,46 @@
 
 #include "util.h"
 #include "mesh.h"
-#include "material.h"
+#include "camera.h"
+#include "stream.h"
 
+enum { maxParticles = 100 };
+
+/*
+ * prevPos is where the particle was before the last simulation step
+ */
 typedef struct {
-	Vec3f pos, vel, initPos, initVel;
+	Vec3f pos, prevPos, vel, initPos, initVel;
 	float speed;
 	bool jump;
 } Particle;
 
+/*
+ * The particles are drawn as point sprites, the positions of the live ones are packed straight into the frame's stream.
+ * positions, numVisible, pointSize and textured are worked out when the particles are submitted, for when the render queue draws them
+ */
 typedef struct {
 	float size, g;
-	Mesh* mesh;
-	Material material;
 	Particle * particles;
 	bool spawn;
 	int num_particles;
+	StreamRange positions;
+	unsigned int spriteTexture;
+	int numVisible;
+	float pointSize;
+	bool textured;
 } Particles;
 
+/*
+ * The particles as the simulation left them, copied out into each snapshot for the render thread
+ */
+typedef struct {
+	Particle particles[maxParticles];
+	bool spawn;
+} ParticleState;
+
 void initParticles(Particles* particles, DrawingFlags* flags);
 void destroyParticles(Particles* particles);
 void updateParticles(Particles* particles, bool isCollided, Vec3f playerPos, float dt);
-void renderParticles(Particles* particles, DrawingFlags* flags);
+void saveParticleState(Particles* particles, ParticleState* state);
+void renderParticles(Particles* particles, const ParticleState* state, Camera* camera, DrawingFlags* flags, float alpha);
@@ -1,11 +1,15 @@
 #include "player.h"
 #include "gl.h"
+#include "meshcache.h"
+#include "renderqueue.h"
 
 #include <string.h>
 
 #define ROT_AMOUNT (M_PI / 4.0) // amount that rotation will change each frame the controls are pressed
 #define SPEED_AMOUNT 1.0 // amount that speed will change each frame the controls are pressed
 
+void initFrogModel(FrogModel* model, Material green);
+
 /*
  * Update the player's position and velocity with frametime dt
  */
@@ -194,26 +198,45 @@ void initJumpItps(Interpolator * itps, float velY, float g) {
 	memcpy(itps, jumpItps, sizeof(jumpItps));
 }
 
+/*
+ * Remember the current pose as the one before the next step
+ */
+static void savePlayerPose(Player* player) {
+	player->prevPos = player->pos;
+	player->prevYRot = player->yRot;
+	memcpy(player->prevJoints, player->joints, sizeof(player->joints));
+}
+
 /*
  * Initialise the player
  */
 void initPlayer(Player* player) {
+	player->size = 0.05;
+	player->g = 9.8;
+
+	player->mesh = acquireCube();
+	player->material = (Material) { { 0.2, 0.2, 0.2, 0 }, { 0, 1, 0, 0 }, { 1, 1, 1, 0 }, 50 };
+	initFrogModel(&player->model, player->material);
+
+	resetPlayer(player);
+}
+
+/*
+ * Put the player back at the start, ready for a new game. Only the state the simulation owns is touched,
+ * so unlike initPlayer this is safe to call from the simulation thread
+ */
+void resetPlayer(Player* player) {
 	player->pos = (Vec3f) { 0, 0, 4 };
 	player->initPos = player->pos;
 
 	player->xRot = M_PI / 4.0;
 	player->yRot = M_PI;
 	player->speed = 2.0;
-	player->size = 0.05;
-	player->g = 9.8;
 	player->jump = false;
 	player->onLog = false;
 	player->prepare = false;
 	player->ribbit = false;
 
-	player->mesh = createCube();
-	player->material = (Material) { { 0.2, 0.2, 0.2, 0 }, { 0, 1, 0, 0 }, { 1, 1, 1, 0 }, 50 };
-
 	initJoints(player->joints);
 	
 	initPreItps(player->preItps, player->initVel.y, player->g);
@@ -228,13 +251,16 @@ void initPlayer(Player* player) {
 							},
 							-1.0
 						};
+
+	savePlayerPose(player);
 }
 
 /*
  * Cleanup any memory used by the player
  */
 void destroyPlayer(Player* player) {
-	destroyMesh(player->mesh);
+	releaseMesh(player->mesh);
+	destroyLineCache(&player->parabola);
 }
 
 bool playerAnimation(float elapsedTime, Interpolator * interpolators, float * joints) {
@@ -259,6 +285,7 @@ bool ribbitAnimation(float elapsedTime, Interpolator itp, float * joint) {
 void updatePlayer(Player* player, float dt, Controls* controls, float elapsedTime) {
 	static bool isSetStartJump = false;
 	static bool isJump = false;
+	savePlayerPose(player);
 	if (!player->jump) {
 		// process controls
 		if (controls->up && player->speed < 3.0)
@@ -333,303 +360,249 @@ void updatePlayer(Player* player, float dt, Controls* controls, float elapsedTim
 	}
 }
 
-void renderEye(Mesh * cube, DrawingFlags * flags) {
-	Material gray = { { 0.2, 0.2, 0.2, 0 }, { 0.5, 0.5, 0.5, 0 }, { 1, 1, 1, 0 }, 50 };
-	Material black = { { 0.0, 0.0, 0.0, 0 }, { 0.0, 0.0, 0.0, 0 }, { 1, 1, 1, 0 }, 50 };
-
-	glPushAttrib(GL_CURRENT_BIT | GL_LIGHTING_BIT);
+/*
+ * Shorthands for the steps of a part's transform
+ */
+static FrogOp translate(float x, float y, float z) {
+	return (FrogOp) { translateOp, -1, 0, { x, y, z } };
+}
 
-	glPushMatrix();
-		glScalef(0.15, 0.15, 0.15);
-		applyMaterial(&gray);
-		submitColor(GRAY);
-		renderMesh(cube, flags);
-
-		applyMaterial(&black);
-		submitColor(BLACK);
-		glTranslatef(0, 0, 0.5);
-		glScalef(0.7, 0.7, 0.7);
-		renderMesh(cube, flags);
-	glPopMatrix();
+static FrogOp rotate(float angle, float x, float y, float z) {
+	return (FrogOp) { rotateOp, -1, angle, { x, y, z } };
+}
 
-	glPopAttrib();
+static FrogOp joint(int joint, float x, float y, float z) {
+	return (FrogOp) { jointOp, joint, 0, { x, y, z } };
 }
 
-void renderHead(Material green, Mesh * cube, DrawingFlags * flags, float mouth) {
-	glPushAttrib(GL_CURRENT_BIT | GL_LIGHTING_BIT);
+static FrogOp scale(float x, float y, float z) {
+	return (FrogOp) { scaleOp, -1, 0, { x, y, z } };
+}
 
-	glPushMatrix();
-		applyMaterial(&green);
-		submitColor(GREEN);
-		glPushMatrix();
-			glScalef(0.4, 0.35, 0.2);
-			renderMesh(cube, flags);
-		glPopMatrix();
-		
-		//eyes;
-		glPushMatrix();
-			glTranslatef(0.0, 0.15, 0.17);
-			//right
-			glPushMatrix();
-				glTranslatef(-0.2, 0, 0);
-				renderEye(cube, flags);
-			glPopMatrix();
-			//left
-			glPushMatrix();
-				glTranslatef(0.2, 0, 0);
-				renderEye(cube, flags);
-			glPopMatrix();
-		glPopMatrix();
-
-		//mouth
-		submitColor(RED);
-		
-		glPushMatrix();
-			glScalef(0.03, 0.03, 0.03);
-			renderMesh(cube, flags);
-		glPopMatrix();
-
-		glPushMatrix();
-			glTranslatef(0.0, -0.15, 0.2);
-			glPushMatrix();
-				glRotatef(mouth, -1, 0, 0);
-				glTranslatef(0.0, 0.09, 0.2);
-				applyMaterial(&green);
-				submitColor(GREEN);
-				glScalef(0.4, 0.09, 0.2);
-				renderMesh(cube, flags);
-			glPopMatrix();
-
-			glPushMatrix();
-				glRotatef(mouth, 1, 0, 0);
-				glTranslatef(0.0, -0.09, 0.2);
-				glScalef(0.4, 0.09, 0.2);
-				renderMesh(cube, flags);
-			glPopMatrix();
-		glPopMatrix();
-	glPopMatrix();
+/*
+ * Add a part to the model. The model is fixed, so running out of room is a mistake in it and we stop right there
+ */
+static int addFrogPart(FrogModel* model, int parent, Vec3f size, int color, const FrogOp* ops, int numOps) {
+	if (model->numParts >= maxFrogParts) {
+		printf("The frog model has more than %d parts\n", maxFrogParts);
+		exit(EXIT_FAILURE);
+	}
+	if (numOps > maxFrogOps) {
+		printf("Part %zu of the frog model has %d ops, more than %d\n", model->numParts, numOps, maxFrogOps);
+		exit(EXIT_FAILURE);
+	}
 
-	glPopAttrib();
+	FrogPart* part = &model->parts[model->numParts];
+	part->parent = parent;
+	part->numOps = numOps;
+	memcpy(part->ops, ops, numOps * sizeof(FrogOp));
+	part->size = size;
+	part->color = color;
+	return model->numParts++;
 }
 
-void renderFoot(Material green, Mesh * cube, DrawingFlags * flags, float length) {
-	glPushAttrib(GL_CURRENT_BIT | GL_LIGHTING_BIT);
+#define NO_CUBE ((Vec3f) { 0, 0, 0 })
+#define addPart(model, parent, size, color, ...) \
+	addFrogPart(model, parent, size, color, (FrogOp[]) { __VA_ARGS__ }, sizeof((FrogOp[]) { __VA_ARGS__ }) / sizeof(FrogOp))
 
-	applyMaterial(&green);
-	submitColor(GREEN);
-
-	glPushMatrix();
-		glScalef(0.15, 0.15, length);
-		renderMesh(cube, flags);
-	glPopMatrix();
-	
-	//toes
-	glPushMatrix();
-		glTranslatef(0, -0.1, length + 0.1);
-		// middle
-		glPushMatrix();
-			glScalef(0.05, 0.05, 0.2);
-			renderMesh(cube, flags);
-		glPopMatrix();
-
-		// left
-		glPushMatrix();
-			glTranslatef(0.1, 0.0, 0.0);
-			glRotatef(20, 0, 1, 0);
-			glScalef(0.05, 0.05, 0.2);
-			renderMesh(cube, flags);
-		glPopMatrix();
-
-		// right
-		glPushMatrix();
-			glTranslatef(-0.1, 0.0, 0.0);
-			glRotatef(20, 0, -1, 0);
-			glScalef(0.05, 0.05, 0.2);
-			renderMesh(cube, flags);
-		glPopMatrix();
-	glPopMatrix();
-
-	glPopAttrib();
+static void addEye(FrogModel* model, int head, float x) {
+	int eye = addPart(model, head, NO_CUBE, frogGreen, translate(x, 0, 0), scale(0.15, 0.15, 0.15));
+	addPart(model, eye, ((Vec3f) { 1, 1, 1 }), frogGray, translate(0, 0, 0));
+	addPart(model, eye, ((Vec3f) { 0.7, 0.7, 0.7 }), frogBlack, translate(0, 0, 0.5));
 }
 
-void renderFrontLeg(Material green, Mesh * cube, DrawingFlags * flags, float elbow) {
-	glPushAttrib(GL_CURRENT_BIT | GL_LIGHTING_BIT);
-
-	applyMaterial(&green);
-	submitColor(GREEN);
+static void addHead(FrogModel* model, int torso) {
+	int head = addPart(model, torso, NO_CUBE, frogGreen, translate(0.0, 0.0, 0.55));
+	addPart(model, head, ((Vec3f) { 0.4, 0.35, 0.2 }), frogGreen, translate(0, 0, 0));
 
-	glPushMatrix();
-		glPushMatrix();
-			glScalef(0.15, 0.15, 0.3);
-			renderMesh(cube, flags);
-		glPopMatrix();
+	//eyes
+	int eyes = addPart(model, head, NO_CUBE, frogGreen, translate(0.0, 0.15, 0.17));
+	addEye(model, eyes, -0.2);
+	addEye(model, eyes, 0.2);
 
-		glTranslatef(0.0, 0.0, -0.3);
-		glRotatef(elbow, -1, 0, 0);
+	//mouth
+	addPart(model, head, ((Vec3f) { 0.03, 0.03, 0.03 }), frogRed, translate(0, 0, 0));
+	int jaw = addPart(model, head, NO_CUBE, frogGreen, translate(0.0, -0.15, 0.2));
+	addPart(model, jaw, ((Vec3f) { 0.4, 0.09, 0.2 }), frogGreen, joint(mouth, -1, 0, 0), translate(0.0, 0.09, 0.2));
+	addPart(model, jaw, ((Vec3f) { 0.4, 0.09, 0.2 }), frogGreen, joint(mouth, 1, 0, 0), translate(0.0, -0.09, 0.2));
+}
 
-		glTranslatef(0.0, 0.0, 0.3);
-		renderFoot(green, cube, flags, 0.3);
-	glPopMatrix();
+static void addFoot(FrogModel* model, int ankle, float length) {
+	addPart(model, ankle, ((Vec3f) { 0.15, 0.15, length }), frogGreen, translate(0, 0, 0));
 
-	glPopAttrib();
+	//toes
+	int toes = addPart(model, ankle, NO_CUBE, frogGreen, translate(0, -0.1, length + 0.1));
+	addPart(model, toes, ((Vec3f) { 0.05, 0.05, 0.2 }), frogGreen, translate(0, 0, 0));
+	addPart(model, toes, ((Vec3f) { 0.05, 0.05, 0.2 }), frogGreen, translate(0.1, 0.0, 0.0), rotate(20, 0, 1, 0));
+	addPart(model, toes, ((Vec3f) { 0.05, 0.05, 0.2 }), frogGreen, translate(-0.1, 0.0, 0.0), rotate(20, 0, -1, 0));
 }
 
-void renderRearLeg(Material green, Mesh * cube, DrawingFlags * flags,
-					float knee, float ankle) {
-	glPushAttrib(GL_CURRENT_BIT | GL_LIGHTING_BIT);
-
-	applyMaterial(&green);
-	submitColor(GREEN);
+static void addFrontLeg(FrogModel* model, int leg) {
+	addPart(model, leg, ((Vec3f) { 0.15, 0.15, 0.3 }), frogGreen, translate(0, 0, 0));
+	int wrist = addPart(model, leg, NO_CUBE, frogGreen, translate(0.0, 0.0, -0.3), joint(elbow, -1, 0, 0), translate(0.0, 0.0, 0.3));
+	addFoot(model, wrist, 0.3);
+}
 
-	glPushMatrix();
-		glPushMatrix();
-			glScalef(0.15, 0.15, 0.4);
-			renderMesh(cube, flags);
-		glPopMatrix();
+static void addRearLeg(FrogModel* model, int leg) {
+	addPart(model, leg, ((Vec3f) { 0.15, 0.15, 0.4 }), frogGreen, translate(0, 0, 0));
+	int shin = addPart(model, leg, NO_CUBE, frogGreen, translate(0.0, 0.0, -0.4), joint(knee, -1, 0, 0), translate(0.0, 0.0, 0.3));
+	addPart(model, shin, ((Vec3f) { 0.15, 0.15, 0.3 }), frogGreen, translate(0, 0, 0));
+	int foot = addPart(model, shin, NO_CUBE, frogGreen, translate(0.0, 0.0, 0.3), joint(ankle, -1, 0, 0), translate(0.0, 0.0, 0.5));
+	addFoot(model, foot, 0.5);
+}
 
-		glTranslatef(0.0, 0.0, -0.4);
-		glRotatef(knee, -1, 0, 0);
+/*
+ * Describe the frog as a hierarchy of boxes driven by the player's joints
+ */
+void initFrogModel(FrogModel* model, Material green) {
+	model->numParts = 0;
+
+	// frog's torso, raised to be on the ground
+	int torso = addPart(model, -1, NO_CUBE, frogGreen, translate(0.0, 1.0, 0.5), joint(body, -1, 0, 0));
+	addPart(model, torso, ((Vec3f) { 0.4, 0.4, 0.8 }), frogGreen, translate(0.0, 0.0, -0.35));
+
+	// frog's head
+	addHead(model, torso);
+
+	// frog's front left leg
+	addFrontLeg(model, addPart(model, torso, NO_CUBE, frogGreen,
+		translate(0.4, -0.35, 0.4), joint(shoulder, -1, 0, 0), translate(0.13, -0.15, -0.25),
+		rotate(10, 0, 1, 0), rotate(10, 0, 0, 1)));
+
+	// frog's front right leg
+	addFrontLeg(model, addPart(model, torso, NO_CUBE, frogGreen,
+		translate(-0.27, -0.35, 0.4), joint(shoulder, -1, 0, 0), translate(-0.26, -0.15, -0.25),
+		rotate(10, 0, -1, 0), rotate(10, 0, 0, -1)));
+
+	// frog's rear left leg
+	addRearLeg(model, addPart(model, torso, NO_CUBE, frogGreen,
+		translate(0.4, 0.0, -1.15), joint(waist, -1, 0, 0), translate(0.15, 0.0, -0.4),
+		rotate(30, 0, -1, 0), rotate(10, 0, 0, -1)));
+
+	// frog's rear right leg
+	addRearLeg(model, addPart(model, torso, NO_CUBE, frogGreen,
+		translate(-0.4, 0.0, -1.15), joint(waist, -1, 0, 0), translate(-0.15, 0.0, -0.4),
+		rotate(30, 0, 1, 0), rotate(10, 0, 0, 1)));
+
+	model->materials[frogGreen] = green;
+	model->materials[frogRed] = green;
+	model->materials[frogGray] = (Material) { { 0.2, 0.2, 0.2, 0 }, { 0.5, 0.5, 0.5, 0 }, { 1, 1, 1, 0 }, 50 };
+	model->materials[frogBlack] = (Material) { { 0.0, 0.0, 0.0, 0 }, { 0.0, 0.0, 0.0, 0 }, { 1, 1, 1, 0 }, 50 };
+	model->colors[frogGreen] = GREEN;
+	model->colors[frogRed] = RED;
+	model->colors[frogGray] = GRAY;
+	model->colors[frogBlack] = BLACK;
+}
 
-		glTranslatef(0.0, 0.0, 0.3);
-		glPushMatrix();
-			glScalef(0.15, 0.15, 0.3);
-			renderMesh(cube, flags);
-		glPopMatrix();
+/*
+ * Scratch space for the transform of each node of the hierarchy
+ */
+static struct {
+	Mat4f* nodes;
+	size_t maxNodes;
+} frogNodes;
 
-		glTranslatef(0.0, 0.0, 0.3);
-		glRotatef(ankle, -1, 0, 0);
+/*
+ * Submit a number of frogs with the same model, each with its own base transform and set of n_joints joint angles.
+ * Every part matrix is worked out in one pass over the hierarchy, and the render queue merges parts of the same colour,
+ * so there is a draw call per colour no matter how many frogs there are
+ */
+void renderFrogs(FrogModel* model, Mesh* cube, const Mat4f* bases, const float* joints, size_t numFrogs, DrawingFlags* flags) {
+	if (model->numParts > frogNodes.maxNodes) {
+		frogNodes.maxNodes = model->numParts;
+		frogNodes.nodes = (Mat4f*) realloc(frogNodes.nodes, frogNodes.maxNodes * sizeof(Mat4f));
+	}
 
-		glTranslatef(0.0, 0.0, 0.5);
-		renderFoot(green, cube, flags, 0.5);
-	glPopMatrix();
+	DrawState states[n_frog_colors];
+	for (int c = 0; c < n_frog_colors; ++c)
+		states[c] = makeDrawState(&model->materials[c], model->colors[c], flags);
+
+	for (size_t f = 0; f < numFrogs; ++f) {
+		const float* angles = joints + f * n_joints;
+
+		for (size_t i = 0; i < model->numParts; ++i) {
+			FrogPart* part = &model->parts[i];
+			Mat4f m = part->parent < 0 ? bases[f] : frogNodes.nodes[part->parent];
+
+			for (int j = 0; j < part->numOps; ++j) {
+				FrogOp op = part->ops[j];
+				switch (op.type) {
+					case translateOp:
+						m = translateMat4f(m, op.v.x, op.v.y, op.v.z);
+						break;
+					case rotateOp:
+						m = rotateMat4f(m, op.angle, op.v.x, op.v.y, op.v.z);
+						break;
+					case jointOp:
+						m = rotateMat4f(m, angles[op.joint], op.v.x, op.v.y, op.v.z);
+						break;
+					case scaleOp:
+						m = scaleMat4f(m, op.v.x, op.v.y, op.v.z);
+						break;
+					default:
+						break;
+				}
+			}
+			frogNodes.nodes[i] = m;
 
-	glPopAttrib();
+			if (part->size.x != 0) {
+				Mat4f cubeTransform = scaleMat4f(m, part->size.x, part->size.y, part->size.z);
+				submitMesh(cube, &cubeTransform, &states[part->color]);
+			}
+		}
+	}
 }
 
 /*
- * Render a car
+ * Copy out everything renderPlayer needs from the simulation's side of the player
  */
-void renderFrog(Player * player, DrawingFlags* flags) {
-	Mesh * cube = player->mesh;
-	Material green = player->material;
-
-	glPushAttrib(GL_CURRENT_BIT | GL_LIGHTING_BIT);
-
-	glPushMatrix();
-		glTranslatef(0.0, 1.0, 0.5); // to be on the ground
-		// frog's torso
-		glRotatef(player->joints[body], -1, 0, 0);
-		glPushMatrix();
-			applyMaterial(&green);
-			submitColor(GREEN);
-			glTranslatef(0.0, 0.0, -0.35);
-			glScalef(0.4, 0.4, 0.8);
-			renderMesh(cube, flags);
-		glPopMatrix();
-
-		// frog's head
-		glPushMatrix();
-			glTranslatef(0.0, 0.0 , 0.55);
-			renderHead(green, cube, flags, player->joints[mouth]);
-		glPopMatrix();
-
-		// frog's front left leg
-		glPushMatrix();
-			glTranslatef(0.4, -0.35, 0.4);
-			glRotatef(player->joints[shoulder], -1, 0, 0);
-
-			glTranslatef(0.13, -0.15, -0.25);
-			applyMaterial(&green);
-			submitColor(GREEN);
-
-			glPushMatrix();
-				glRotatef(10, 0, 1, 0);
-				glRotatef(10, 0, 0, 1);
-				renderFrontLeg(green, cube, flags, player->joints[elbow]);
-			glPopMatrix();
-		glPopMatrix();
-
-		// frog's front right leg
-		glPushMatrix();
-			glTranslatef(-0.27, -0.35, 0.4);
-			glRotatef(player->joints[shoulder], -1, 0, 0);
-
-			glTranslatef(-0.13, -0.15, -0.25);
-			applyMaterial(&green);
-			submitColor(GREEN);
-
-			glPushMatrix();
-				glTranslatef(-0.13, 0.0, 0.0);
-				glRotatef(10, 0, -1, 0);
-				glRotatef(10, 0, 0, -1);
-				renderFrontLeg(green, cube, flags, player->joints[elbow]);
-			glPopMatrix();
-		glPopMatrix();
-
-		// frog's rear left leg
-		glPushMatrix();
-			glTranslatef(0.4, 0.0, -1.15);
-			glRotatef(player->joints[waist], -1, 0, 0);
-
-			glTranslatef(0.15, 0.0, -0.4);
-			applyMaterial(&green);
-			submitColor(GREEN);
-
-			glPushMatrix();
-				glRotatef(30, 0, -1, 0);
-				glRotatef(10, 0, 0, -1);
-				renderRearLeg(green, cube, flags, player->joints[knee], player->joints[ankle]);
-			glPopMatrix();
-		glPopMatrix();
-
-		// frog's rear right leg
-		glPushMatrix();
-			glTranslatef(-0.4, 0.0, -1.15);
-			glRotatef(player->joints[waist], -1, 0, 0);
-
-			glTranslatef(-0.15, 0.0, -0.4);
-			applyMaterial(&green);
-			submitColor(GREEN);
-
-			glPushMatrix();
-				glRotatef(30, 0, 1, 0);
-				glRotatef(10, 0, 0, 1);
-				renderRearLeg(green, cube, flags, player->joints[knee], player->joints[ankle]);
-			glPopMatrix();
-		glPopMatrix();
-	glPopMatrix();
-
-	glPopAttrib();
+void savePlayerState(Player* player, PlayerState* state) {
+	state->pos = player->pos;
+	state->prevPos = player->prevPos;
+	state->vel = player->vel;
+	state->initPos = player->initPos;
+	state->initVel = player->initVel;
+	state->yRot = player->yRot;
+	state->prevYRot = player->prevYRot;
+	memcpy(state->joints, player->joints, sizeof(state->joints));
+	memcpy(state->prevJoints, player->prevJoints, sizeof(state->prevJoints));
 }
 
 /*
- * Draw the player's mesh, as well as a parabola showing our jump arc and a visualization of our current velocity
+ * Submit the player's mesh in the pose from a snapshot, and draw a parabola showing our jump arc and a visualization of our current velocity
  */
-void renderPlayer(Player* player, DrawingFlags* flags) {
-	glPushAttrib(GL_CURRENT_BIT | GL_LIGHTING_BIT);
+void renderPlayer(Player* player, const PlayerState* state, Camera* camera, DrawingFlags* flags, float alpha) {
+	glPushAttrib(GL_CURRENT_BIT);
 
 	// draw the parabola from the starting point of the jump
 	glPushMatrix();
-	glTranslatef(player->initPos.x, player->initPos.y, player->initPos.z);
-	drawParabola(BLUE, player->initVel, player->g, flags);
+	glTranslatef(state->initPos.x, state->initPos.y, state->initPos.z);
+	setDebugTransform(NULL);
+	drawParabola(&player->parabola, BLUE, state->initVel, player->g, flags);
 	glPopMatrix();
 
-	glPushMatrix();
-	glTranslatef(player->pos.x, player->pos.y, player->pos.z);
+	// draw the player alpha of the way from its pose before the last step to its current one
+	Vec3f pos = lerpVec3f(state->prevPos, state->pos, alpha);
+	float yRot = state->prevYRot + (state->yRot - state->prevYRot) * alpha;
+	float joints[n_joints];
+	for (int i = 0; i < n_joints; ++i)
+		joints[i] = state->prevJoints[i] + (state->joints[i] - state->prevJoints[i]) * alpha;
+
+	// the legs can stretch out about 3 times the frog's size from its middle
+	Vec3f center = { pos.x, pos.y + player->size, pos.z };
+	if (isSphereVisible(camera, center, player->size * 3.0)) {
+		Mat4f base = identityMat4f();
+		base = translateMat4f(base, pos.x, pos.y, pos.z);
+		base = rotateMat4f(base, RADDEG(yRot), 0, 1, 0);
+		base = scaleMat4f(base, player->size, player->size, player->size);
+		renderFrogs(&player->model, player->mesh, &base, joints, 1, flags);
+	}
 
-	// draw the player mesh at our current position
-	glPushMatrix();
-	glRotatef(RADDEG(player->yRot), 0, 1, 0);
-	glScalef(player->size, player->size, player->size);
-	applyMaterial(&player->material);
-	glColor3f(0.1, 0.5, 0.9);
-	renderFrog(player, flags);
-	glPopMatrix();
-	
 	// draw the visualization of the player's velocity at our current position
-	glBegin(GL_LINES);
-	drawLine(PURPLE, (Vec3f) { 0, 0, 0 }, mulVec3f(player->vel, 0.1)); 
-	glEnd();
+	glPushMatrix();
+	glTranslatef(pos.x, pos.y, pos.z);
+	setDebugTransform(NULL);
+	drawLine(PURPLE, (Vec3f) { 0, 0, 0 }, mulVec3f(state->vel, 0.1)); 
 	glPopMatrix();
 
 	glPopAttrib();
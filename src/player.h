@@ -5,6 +5,8 @@
 #include "mesh.h"
 #include "material.h"
 #include "anim.h"
+#include "debug.h"
+#include "camera.h"
 
 /*
  * Our player has position and velocity, which are set from the speed and rotation parameters
@@ -12,19 +14,70 @@
  */
 enum { body, mouth, shoulder, elbow, waist, knee, ankle, n_joints } Joint;
 
+enum { frogGreen, frogRed, frogGray, frogBlack, n_frog_colors };
+enum { translateOp, rotateOp, jointOp, scaleOp };
+enum { maxFrogOps = 6, maxFrogParts = 64 };
+
+/*
+ * One step of a part's transform relative to its parent. jointOp rotates around axis by the angle of a joint
+ */
+typedef struct {
+	int type;
+	int joint;
+	float angle;
+	Vec3f v;
+} FrogOp;
+
+/*
+ * A node of the frog's hierarchy. Parents always come before their children in the list.
+ * If size isn't zero a cube of that size is drawn at the node in one of the frog's colours
+ */
+typedef struct {
+	int parent;
+	FrogOp ops[maxFrogOps];
+	int numOps;
+	Vec3f size;
+	int color;
+} FrogPart;
+
 typedef struct {
-	Vec3f pos, vel, initPos, initVel;
-	float speed, xRot, yRot, size, g;
+	FrogPart parts[maxFrogParts];
+	size_t numParts;
+	Material materials[n_frog_colors];
+	Vec3f colors[n_frog_colors];
+} FrogModel;
+
+/*
+ * prevPos, prevYRot and prevJoints are the pose before the last simulation step, the frog is drawn somewhere between the two
+ */
+typedef struct {
+	Vec3f pos, prevPos, vel, initPos, initVel;
+	float speed, xRot, yRot, prevYRot, size, g;
 	bool jump, onLog, prepare, ribbit;
 	Mesh* mesh;
 	Material material;
-	float joints[n_joints];
+	FrogModel model;
+	float joints[n_joints], prevJoints[n_joints];
 	Interpolator preItps[n_joints];
 	Interpolator jumpItps[n_joints];
 	Interpolator ribbitItp;
+	LineCache parabola;
 } Player;
 
+/*
+ * The part of the player that the simulation changes and the renderer needs, copied out into each snapshot.
+ * The model, mesh, size, gravity and parabola cache never change after initPlayer so the renderer reads them from the Player
+ */
+typedef struct {
+	Vec3f pos, prevPos, vel, initPos, initVel;
+	float yRot, prevYRot;
+	float joints[n_joints], prevJoints[n_joints];
+} PlayerState;
+
 void initPlayer(Player* player);
+void resetPlayer(Player* player);
 void destroyPlayer(Player* player);
 void updatePlayer(Player* player, float dt, Controls* controls, float elapsedTime);
-void renderPlayer(Player* player, DrawingFlags* flags);
+void savePlayerState(Player* player, PlayerState* state);
+void renderFrogs(FrogModel* model, Mesh* cube, const Mat4f* bases, const float* joints, size_t numFrogs, DrawingFlags* flags);
+void renderPlayer(Player* player, const PlayerState* state, Camera* camera, DrawingFlags* flags, float alpha);
@@ -0,0 +1,299 @@
+#include "renderqueue.h"
+#include "gl.h"
+#include "glstate.h"
+#include "texcache.h"
+#include "shader.h"
+
+#include <string.h>
+#include <stdint.h>
+
+/*
+ * The sort key, from the most significant bits down: the layer, then for opaque items the texture, the rest of the state,
+ * the mesh and the depth, and for transparent items the depth from back to front. Custom items sort after the meshes of their layer
+ */
+enum { depthBits = 16, meshBits = 14, stateBits = 12, textureBits = 8 };
+enum { meshShift = depthBits, stateShift = meshShift + meshBits, textureShift = stateShift + stateBits, layerShift = 62 };
+enum { maxStates = 1 << stateBits, maxTextures = (1 << textureBits) - 1, maxMeshes = 1 << meshBits, customTexture = maxTextures };
+
+typedef struct {
+	uint64_t key;
+	Mesh* mesh;
+	Mat4f transform;
+	int state;
+	DrawFunc draw;
+	void* data;
+} DrawItem;
+
+typedef struct {
+	unsigned int texture;
+	int atlasCell;
+	bool textured;
+} TextureState;
+
+static struct {
+	Camera* camera;
+	DrawItem* items;
+	size_t numItems, maxItems;
+	DrawState states[maxStates];
+	int numStates;
+	TextureState textures[maxTextures];
+	int numTextures;
+	Mesh* meshes[maxMeshes];
+	int numMeshes;
+	Mat4f* transforms;
+	size_t maxTransforms;
+	int atlasCell;
+	float depthBias;
+	bool shaded;
+	Material materials[maxShaderMaterials];
+	int stateMaterials[maxStates];
+} queue;
+
+static bool sameDrawState(const DrawState* a, const DrawState* b) {
+	return memcmp(&a->material, &b->material, sizeof(Material)) == 0
+		&& memcmp(&a->color, &b->color, sizeof(Vec4f)) == 0
+		&& a->texture == b->texture && a->atlasCell == b->atlasCell && a->layer == b->layer && a->depthBias == b->depthBias
+		&& a->flags.normals == b->flags.normals && a->flags.wireframe == b->flags.wireframe
+		&& a->flags.lighting == b->flags.lighting && a->flags.textures == b->flags.textures
+		&& a->flags.axes == b->flags.axes && a->flags.segments == b->flags.segments;
+}
+
+/*
+ * Give a state, texture or mesh a small number for this frame, so they fit in the sort key
+ */
+static int internState(const DrawState* state) {
+	for (int i = 0; i < queue.numStates; ++i)
+		if (sameDrawState(&queue.states[i], state))
+			return i;
+	if (queue.numStates == maxStates)
+		return maxStates - 1;
+	queue.states[queue.numStates] = *state;
+	return queue.numStates++;
+}
+
+static int internTexture(const DrawState* state) {
+	TextureState texture = { state->texture, state->atlasCell, state->flags.textures };
+	for (int i = 0; i < queue.numTextures; ++i)
+		if (queue.textures[i].texture == texture.texture && queue.textures[i].atlasCell == texture.atlasCell
+			&& queue.textures[i].textured == texture.textured)
+			return i;
+	if (queue.numTextures == maxTextures)
+		return maxTextures - 1;
+	queue.textures[queue.numTextures] = texture;
+	return queue.numTextures++;
+}
+
+static int internMesh(Mesh* mesh) {
+	for (int i = 0; i < queue.numMeshes; ++i)
+		if (queue.meshes[i] == mesh)
+			return i;
+	if (queue.numMeshes == maxMeshes)
+		return maxMeshes - 1;
+	queue.meshes[queue.numMeshes] = mesh;
+	return queue.numMeshes++;
+}
+
+/*
+ * How far a point is from the camera, scaled to the depth bits of the key
+ */
+static uint64_t quantizeDepth(Vec3f pos) {
+	Vec3f d = { pos.x - queue.camera->eye.x, pos.y - queue.camera->eye.y, pos.z - queue.camera->eye.z };
+	float depth = clamp(magVec3f(d) / queue.camera->far, 0.0f, 1.0f);
+	return (uint64_t) (depth * ((1 << depthBits) - 1));
+}
+
+static DrawItem* newItem() {
+	if (queue.numItems == queue.maxItems) {
+		queue.maxItems = max(queue.maxItems * 2, 256);
+		queue.items = (DrawItem*) realloc(queue.items, queue.maxItems * sizeof(DrawItem));
+	}
+	return &queue.items[queue.numItems++];
+}
+
+/*
+ * An opaque, untextured state with the given material and colour
+ */
+DrawState makeDrawState(const Material* material, Vec3f color, DrawingFlags* flags) {
+	return (DrawState) { *material, { color.x, color.y, color.z, 1 }, 0, -1, opaqueLayer, 0, *flags };
+}
+
+/*
+ * Start a new frame seen from the given camera, whose view should already be applied
+ */
+void beginRenderQueue(Camera* camera) {
+	queue.camera = camera;
+	queue.numItems = 0;
+	queue.numStates = 0;
+	queue.numTextures = 0;
+	queue.numMeshes = 0;
+}
+
+void submitMesh(Mesh* mesh, const Mat4f* transform, const DrawState* state) {
+	DrawItem* item = newItem();
+	item->mesh = mesh;
+	item->transform = *transform;
+	item->state = internState(state);
+	item->draw = NULL;
+	item->data = NULL;
+
+	uint64_t depth = quantizeDepth(transformPointMat4f(*transform, mesh->center));
+	uint64_t layer = (uint64_t) state->layer << layerShift;
+	if (state->layer == transparentLayer)
+		item->key = layer | (((1 << depthBits) - 1) - depth);
+	else
+		item->key = layer | (uint64_t) internTexture(state) << textureShift | (uint64_t) item->state << stateShift
+			| (uint64_t) internMesh(mesh) << meshShift | depth;
+}
+
+void submitCustom(int layer, Vec3f pos, DrawFunc draw, void* data) {
+	DrawItem* item = newItem();
+	item->mesh = NULL;
+	item->state = -1;
+	item->draw = draw;
+	item->data = data;
+
+	uint64_t depth = quantizeDepth(pos);
+	if (layer == transparentLayer)
+		item->key = (uint64_t) layer << layerShift | (((1 << depthBits) - 1) - depth);
+	else
+		item->key = (uint64_t) layer << layerShift | (uint64_t) customTexture << textureShift | depth;
+}
+
+static int compareItems(const void* a, const void* b) {
+	uint64_t ka = ((const DrawItem*) a)->key, kb = ((const DrawItem*) b)->key;
+	return ka < kb ? -1 : ka > kb;
+}
+
+static void setAtlasCell(int cell) {
+	if (cell == queue.atlasCell)
+		return;
+	if (cell < 0)
+		clearAtlasCell();
+	else
+		selectAtlasCell(cell);
+	queue.atlasCell = cell;
+}
+
+static void setDepthBias(float bias) {
+	if (bias == queue.depthBias)
+		return;
+	if (bias == 0) {
+		glDisable(GL_POLYGON_OFFSET_FILL);
+	} else {
+		glEnable(GL_POLYGON_OFFSET_FILL);
+		glPolygonOffset(bias, bias);
+	}
+	queue.depthBias = bias;
+}
+
+static void applyDrawState(int index) {
+	const DrawState* state = &queue.states[index];
+	bindTexture(GL_TEXTURE_2D, state->texture);
+	setDepthBias(state->depthBias);
+
+	// transparent items blend over what's already there and are hidden by opaque things in front,
+	// but don't write depth, so they can't hide each other or anything drawn after them
+	bool transparent = state->layer == transparentLayer;
+	setEnabled(GL_BLEND, transparent);
+	setDepthMask(!transparent);
+	if (transparent)
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	if (queue.shaded) {
+		setShaderDrawState(queue.stateMaterials[index], state->color, state->flags.lighting,
+			state->flags.textures && state->texture, getAtlasCellRect(state->atlasCell));
+		return;
+	}
+
+	setAtlasCell(state->atlasCell);
+	Material material = state->material;
+	applyMaterial(&material);
+	glColor4fv((const GLfloat*) &state->color);
+}
+
+/*
+ * Give the shaders a table of this frame's materials, and each state the index of its material in it
+ */
+static void uploadMaterials() {
+	int numMaterials = 0;
+	for (int i = 0; i < queue.numStates; ++i) {
+		const Material* material = &queue.states[i].material;
+		int m = 0;
+		while (m < numMaterials && memcmp(&queue.materials[m], material, sizeof(Material)) != 0)
+			++m;
+		if (m == numMaterials && numMaterials < maxShaderMaterials)
+			queue.materials[numMaterials++] = *material;
+		queue.stateMaterials[i] = min(m, maxShaderMaterials - 1);
+	}
+	uploadShaderMaterials(queue.materials, numMaterials);
+}
+
+/*
+ * Sort everything submitted this frame and draw it
+ */
+void flushRenderQueue() {
+	qsort(queue.items, queue.numItems, sizeof(DrawItem), compareItems);
+
+	glPushAttrib(GL_CURRENT_BIT);
+	queue.atlasCell = -1;
+	queue.depthBias = 0;
+	queue.shaded = shadersEnabled();
+	if (queue.shaded)
+		uploadMaterials();
+
+	for (size_t i = 0; i < queue.numItems;) {
+		DrawItem* item = &queue.items[i];
+		if (item->draw) {
+			setAtlasCell(-1);
+			setDepthBias(0);
+			useProgram(0);
+			item->draw(item->data);
+			++i;
+			continue;
+		}
+
+		DrawState* state = &queue.states[item->state];
+		applyDrawState(item->state);
+
+		// opaque items next to each other with the same mesh and state only differ by depth, so they can go in one draw
+		size_t n = 1;
+		if (state->layer != transparentLayer) {
+			while (i + n < queue.numItems && queue.items[i + n].mesh == item->mesh && queue.items[i + n].state == item->state)
+				++n;
+		}
+
+		// the shaders take the transforms as instance data, so they draw every run the same way
+		if (queue.shaded || n > 1) {
+			if (n > queue.maxTransforms) {
+				queue.maxTransforms = n;
+				queue.transforms = (Mat4f*) realloc(queue.transforms, n * sizeof(Mat4f));
+			}
+			for (size_t j = 0; j < n; ++j)
+				queue.transforms[j] = queue.items[i + j].transform;
+			if (queue.shaded)
+				renderMeshShaded(item->mesh, queue.transforms, n, &state->flags);
+			else
+				renderMeshInstanced(item->mesh, queue.transforms, n, &state->flags);
+		} else {
+			glPushMatrix();
+			glMultMatrixf(item->transform.m);
+			renderMesh(item->mesh, &state->flags);
+			glPopMatrix();
+		}
+		i += n;
+	}
+
+	setAtlasCell(-1);
+	setDepthBias(0);
+	useProgram(0);
+	bindTexture(GL_TEXTURE_2D, 0);
+	setEnabled(GL_BLEND, false);
+	setDepthMask(true);
+	glPopAttrib();
+}
+
+void destroyRenderQueue() {
+	free(queue.items);
+	free(queue.transforms);
+	memset(&queue, 0, sizeof(queue));
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "mesh.h"
+#include "material.h"
+#include "camera.h"
+
+/*
+ * Everything in the frame is submitted to the render queue instead of being drawn straight away.
+ * Opaque items are sorted by texture, then material, then mesh so the state changes as little as possible, and front to back
+ * within that for early depth rejection. The sky goes after the opaque items and transparent items go last, back to front,
+ * blended and depth tested against everything opaque without writing any depth of their own.
+ * Opaque items with the same mesh and state are merged into instanced draws
+ */
+enum { opaqueLayer, skyLayer, transparentLayer, n_render_layers };
+
+/*
+ * How a mesh is drawn. atlasCell is the cell of texture to use if it is an atlas, or -1.
+ * depthBias pulls the mesh towards the camera (when negative) so it wins the depth test against a surface in the same place
+ */
+typedef struct {
+	Material material;
+	Vec4f color;
+	unsigned int texture;
+	int atlasCell;
+	int layer;
+	float depthBias;
+	DrawingFlags flags;
+} DrawState;
+
+/*
+ * For things that aren't a mesh with a transform, like the sky or the particles, which draw themselves
+ */
+typedef void (*DrawFunc)(void* data);
+
+DrawState makeDrawState(const Material* material, Vec3f color, DrawingFlags* flags);
+
+void beginRenderQueue(Camera* camera);
+void submitMesh(Mesh* mesh, const Mat4f* transform, const DrawState* state);
+void submitCustom(int layer, Vec3f pos, DrawFunc draw, void* data);
+void flushRenderQueue();
+void destroyRenderQueue();
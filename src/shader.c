@@ -0,0 +1,232 @@
+#include "shader.h"
+#include "gl.h"
+#include "glstate.h"
+#include "archive.h"
+#include "stream.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+
+enum { positionAttrib, normalAttrib, texCoordAttrib, modelAttrib };
+
+/*
+ * A material as the std140 Materials block in mesh.vert lays it out, with the shininess padded out to a whole vec4
+ */
+typedef struct {
+	Vec4f ambient, diffuse, specular;
+	float shininess, pad[3];
+} ShaderMaterial;
+
+static struct {
+	bool enabled;
+	unsigned int program;
+	unsigned int materialBuffer;
+	int view, projection, lightDir, material, color, lighting, textured, atlasRect, tex;
+} shaders;
+
+/*
+ * Compile one stage from an asset, printing the log and returning 0 if it doesn't build
+ */
+static unsigned int compileShader(GLenum type, const char* path) {
+	size_t size;
+	const char* source = (const char*) findAsset(path, &size);
+	if (!source) {
+		printf("Can't find shader %s\n", path);
+		return 0;
+	}
+
+	unsigned int shader = glCreateShader(type);
+	GLint length = size;
+	glShaderSource(shader, 1, &source, &length);
+	glCompileShader(shader);
+
+	GLint ok;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+	if (!ok) {
+		char log[1024];
+		glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+		printf("Can't compile %s:\n%s\n", path, log);
+		glDeleteShader(shader);
+		return 0;
+	}
+	return shader;
+}
+
+static unsigned int linkProgram(const char* vertPath, const char* fragPath) {
+	unsigned int vert = compileShader(GL_VERTEX_SHADER, vertPath);
+	unsigned int frag = compileShader(GL_FRAGMENT_SHADER, fragPath);
+	if (!vert || !frag) {
+		glDeleteShader(vert);
+		glDeleteShader(frag);
+		return 0;
+	}
+
+	unsigned int program = glCreateProgram();
+	glAttachShader(program, vert);
+	glAttachShader(program, frag);
+	glLinkProgram(program);
+	glDeleteShader(vert);
+	glDeleteShader(frag);
+
+	GLint ok;
+	glGetProgramiv(program, GL_LINK_STATUS, &ok);
+	if (!ok) {
+		char log[1024];
+		glGetProgramInfoLog(program, sizeof(log), NULL, log);
+		printf("Can't link %s and %s:\n%s\n", vertPath, fragPath, log);
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
+
+/*
+ * Build the mesh program and its buffers. Returns false, leaving the pipeline off, if the driver isn't up to it
+ */
+bool initShaders() {
+	int major = 0, minor = 0;
+	const char* version = (const char*) glGetString(GL_SHADING_LANGUAGE_VERSION);
+	if (!version || sscanf(version, "%d.%d", &major, &minor) != 2 || major * 100 + minor < 330) {
+		printf("GLSL 3.30 isn't available, using the fixed function pipeline\n");
+		return false;
+	}
+
+	shaders.program = linkProgram("res/shaders/mesh.vert", "res/shaders/mesh.frag");
+	if (!shaders.program) {
+		printf("Using the fixed function pipeline\n");
+		return false;
+	}
+
+	shaders.view = glGetUniformLocation(shaders.program, "view");
+	shaders.projection = glGetUniformLocation(shaders.program, "projection");
+	shaders.lightDir = glGetUniformLocation(shaders.program, "lightDir");
+	shaders.material = glGetUniformLocation(shaders.program, "material");
+	shaders.color = glGetUniformLocation(shaders.program, "color");
+	shaders.lighting = glGetUniformLocation(shaders.program, "lighting");
+	shaders.textured = glGetUniformLocation(shaders.program, "textured");
+	shaders.atlasRect = glGetUniformLocation(shaders.program, "atlasRect");
+	shaders.tex = glGetUniformLocation(shaders.program, "tex");
+
+	glGenBuffers(1, &shaders.materialBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, shaders.materialBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, maxShaderMaterials * sizeof(ShaderMaterial), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glUniformBlockBinding(shaders.program, glGetUniformBlockIndex(shaders.program, "Materials"), 0);
+
+	useProgram(shaders.program);
+	glUniform1i(shaders.tex, 0);
+	useProgram(0);
+
+	shaders.enabled = true;
+	printf("Using the shader pipeline\n");
+	return true;
+}
+
+bool shadersEnabled() {
+	return shaders.enabled;
+}
+
+void destroyShaders() {
+	if (!shaders.program)
+		return;
+	useProgram(0);
+	glDeleteProgram(shaders.program);
+	glDeleteBuffers(1, &shaders.materialBuffer);
+	memset(&shaders, 0, sizeof(shaders));
+}
+
+/*
+ * Set up the camera and light for this frame. Like GL_LIGHT0 the light is given in world space,
+ * but only directional lights (w = 0) are supported
+ */
+void beginShaderFrame(Camera* camera, const float* lightPos) {
+	const float* v = camera->view.m;
+	Vec3f dir = normaliseVec3f((Vec3f) {
+		v[0] * lightPos[0] + v[4] * lightPos[1] + v[8] * lightPos[2],
+		v[1] * lightPos[0] + v[5] * lightPos[1] + v[9] * lightPos[2],
+		v[2] * lightPos[0] + v[6] * lightPos[1] + v[10] * lightPos[2]
+	});
+
+	useProgram(shaders.program);
+	glUniformMatrix4fv(shaders.view, 1, GL_FALSE, camera->view.m);
+	glUniformMatrix4fv(shaders.projection, 1, GL_FALSE, camera->projection.m);
+	glUniform3f(shaders.lightDir, dir.x, dir.y, dir.z);
+	useProgram(0);
+}
+
+/*
+ * Fill the material table for this frame, draws then pick from it by index
+ */
+void uploadShaderMaterials(const Material* materials, size_t numMaterials) {
+	ShaderMaterial table[maxShaderMaterials];
+	numMaterials = min(numMaterials, (size_t) maxShaderMaterials);
+	for (size_t i = 0; i < numMaterials; ++i) {
+		table[i] = (ShaderMaterial) { materials[i].ambient, materials[i].diffuse, materials[i].specular,
+			materials[i].shininess, { 0, 0, 0 } };
+	}
+
+	// orphan last frame's table so we don't wait on draws still reading it
+	glBindBuffer(GL_UNIFORM_BUFFER, shaders.materialBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, maxShaderMaterials * sizeof(ShaderMaterial), NULL, GL_DYNAMIC_DRAW);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, numMaterials * sizeof(ShaderMaterial), table);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, 0, shaders.materialBuffer);
+}
+
+/*
+ * Everything the following draws share. textured should only be set if a texture is actually bound,
+ * since sampling nothing gives black in a shader where the fixed function pipeline would skip texturing
+ */
+void setShaderDrawState(int material, Vec4f color, bool lighting, bool textured, Vec4f atlasRect) {
+	useProgram(shaders.program);
+	glUniform1i(shaders.material, material);
+	glUniform4f(shaders.color, color.x, color.y, color.z, color.w);
+	glUniform1i(shaders.lighting, lighting);
+	glUniform1i(shaders.textured, textured);
+	glUniform4f(shaders.atlasRect, atlasRect.x, atlasRect.y, atlasRect.z, atlasRect.w);
+}
+
+/*
+ * Draw copies of a mesh with the state from setShaderDrawState, one per transform, in a single instanced draw
+ */
+void renderMeshShaded(Mesh* mesh, const Mat4f* transforms, size_t numInstances, DrawingFlags* flags) {
+	if (numInstances == 0)
+		return;
+
+	StreamRange instances = allocStream(numInstances * sizeof(Mat4f));
+	memcpy(instances.data, transforms, numInstances * sizeof(Mat4f));
+	commitStream(&instances, numInstances * sizeof(Mat4f));
+
+	// a mat4 attribute is four vec4 columns in consecutive locations
+	glBindBuffer(GL_ARRAY_BUFFER, instances.buffer);
+	for (int i = 0; i < 4; ++i) {
+		glEnableVertexAttribArray(modelAttrib + i);
+		glVertexAttribPointer(modelAttrib + i, 4, GL_FLOAT, GL_FALSE, sizeof(Mat4f),
+			(void*) (instances.offset + i * sizeof(Vec4f)));
+		glVertexAttribDivisor(modelAttrib + i, 1);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ibo);
+	glEnableVertexAttribArray(positionAttrib);
+	glEnableVertexAttribArray(normalAttrib);
+	glEnableVertexAttribArray(texCoordAttrib);
+	glVertexAttribPointer(positionAttrib, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) offsetof(Vertex, pos));
+	glVertexAttribPointer(normalAttrib, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) offsetof(Vertex, normal));
+	glVertexAttribPointer(texCoordAttrib, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) offsetof(Vertex, tc));
+
+	glDrawElementsInstanced(GL_TRIANGLES, mesh->numIndices, GL_UNSIGNED_INT, 0, numInstances);
+
+	glDisableVertexAttribArray(positionAttrib);
+	glDisableVertexAttribArray(normalAttrib);
+	glDisableVertexAttribArray(texCoordAttrib);
+	for (int i = 0; i < 4; ++i) {
+		glVertexAttribDivisor(modelAttrib + i, 0);
+		glDisableVertexAttribArray(modelAttrib + i);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	renderMeshDebug(mesh, transforms, numInstances, flags);
+}
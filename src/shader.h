@@ -0,0 +1,24 @@
+#pragma once
+
+#include "mesh.h"
+#include "material.h"
+#include "camera.h"
+
+/*
+ * An optional GLSL pipeline for the meshes in the render queue, picked at startup with -shaders or FROG_SHADERS=1.
+ * The materials used in a frame live in one uniform buffer and each draw just picks one by index, and the model matrices
+ * are per instance attributes, so every batch in the queue is a single glDrawElementsInstanced with no matrix stack.
+ * It lights and textures things the same way the fixed function pipeline does. The sky, particles, debug lines and OSD
+ * still go through the fixed function pipeline either way.
+ * If the driver can't do GLSL 3.30 or the shaders don't build, initShaders says so and everything stays fixed function
+ */
+enum { maxShaderMaterials = 128 };
+
+bool initShaders();
+bool shadersEnabled();
+void destroyShaders();
+
+void beginShaderFrame(Camera* camera, const float* lightPos);
+void uploadShaderMaterials(const Material* materials, size_t numMaterials);
+void setShaderDrawState(int material, Vec4f color, bool lighting, bool textured, Vec4f atlasRect);
+void renderMeshShaded(Mesh* mesh, const Mat4f* transforms, size_t numInstances, DrawingFlags* flags);
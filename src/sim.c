@@ -0,0 +1,378 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "sim.h"
+#include "ticker.h"
+
+#include <stdio.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+
+/*
+ * How many steps a batch can run to catch up after a slow one, and how many lives a game starts with
+ */
+enum { maxCatchUpSteps = 5, startLives = 5 };
+
+/*
+ * Set in the middle slot index when the simulation has swapped in a snapshot the renderer hasn't picked up yet
+ */
+enum { freshSlot = 4, slotMask = 3 };
+
+static struct {
+	pthread_t thread;
+	bool started;
+	atomic_bool running;
+
+	Player* player;
+	Level* level;
+	Particles* particles;
+	InputQueue* input;
+	unsigned int held, pressed;
+	bool halt, publishedHalt;
+	Ticker ticker;
+	int score, lives;
+	unsigned int resets;
+	unsigned int batches;
+	double batchTime;
+
+	Snapshot slots[3];
+	int back, front;
+	atomic_int middle;
+} sim;
+
+/*
+ * Start a new game with everything back where it began. Unlike initPlayer and initLevel nothing here touches GL
+ */
+static void resetGame() {
+	resetPlayer(sim.player);
+	resetLevel(sim.level);
+	sim.resets++;
+}
+
+static void checkCrossRiver()
+{
+	River* river = &sim.level->river;
+	float riverSidePos = river->pos.z - river->logs->size.x;
+	if (sim.player->pos.z < riverSidePos) {
+		sim.score++;
+		resetGame();
+	}
+}
+
+static void checkInRiver()
+{
+	River* river = &sim.level->river;
+	float riverTopSide = river->pos.z - river->logs->size.x;
+	float riverBottomSide = river->pos.z + river->laneHeight - river->logs->size.x;
+	if (sim.player->pos.y == 0 && !sim.player->onLog &&
+			sim.player->pos.z > riverTopSide && sim.player->pos.z < riverBottomSide) {
+		sim.lives--;
+		resetGame();
+	}
+}
+
+static void attachFrogOnLog(Entity log)
+{
+	Player * frog = sim.player;
+	static Vec3f posOnLog = { 0.0, 0.0, 0.0 };
+	static bool isJump = false;
+	if (!frog->onLog) {
+		posOnLog = (Vec3f) {log.pos.x - frog->pos.x, log.pos.y - frog->pos.y, log.pos.z - frog->pos.z};
+		frog->onLog = true;
+		isJump = frog->jump;
+	}
+
+	// skip the jump which moves to the log
+	if (isJump) {
+		if (frog->jump) {
+			return;
+		} else {
+			isJump = frog->jump;
+		}
+	}
+
+	if (!frog->jump) {
+		frog->pos.x = log.pos.x - posOnLog.x;
+		frog->pos.y = log.pos.y - posOnLog.y;
+		frog->pos.z = log.pos.z - posOnLog.z;
+		frog->initPos = frog->pos;
+	} else {
+		frog->onLog = false;
+	}
+}
+
+static bool checkEnemiesCollision()
+{
+	bool isCollided = false;
+	float distance;
+	float enemyRadius = sim.level->road.enemies->size.x * 1.41421356; // sqrt(2) = 1.41421356;
+	float overlap = (sim.player->size + enemyRadius) * (sim.player->size + enemyRadius);
+
+	Vec3f frog = sim.player->pos;
+	Vec3f enemy;
+
+	Entity * enemies = sim.level->road.enemies;
+
+	for (size_t i = 0; i < sim.level->road.numLanes; ++i) {
+		enemy = enemies->pos;
+		distance = (frog.x - enemy.x) * (frog.x - enemy.x) +
+					(frog.y - enemy.y) * (frog.y - enemy.y) +
+					(frog.z - enemy.z) * (frog.z - enemy.z);
+		if (distance < overlap) {
+			isCollided = true;
+			break;
+
+		}
+		enemies++;
+	}
+	return isCollided;
+}
+
+static bool checkLogsCollision()
+{
+	Vec3f frog = sim.player->pos;
+	Vec3f log;
+
+	bool isCollided = false;
+
+	Entity * logs = sim.level->river.logs;
+	float logLength = logs->size.z;
+	float logHeight = logs->size.y;
+	for (size_t i = 0; i < sim.level->river.numLanes; ++i) {
+		log = logs->pos;
+		Vec3f minPoint = {log.x - logLength / 2.0, 0.0, log.z - logHeight};
+		Vec3f maxPoint = {log.x + logLength / 2.0, 0.0, log.z + logHeight};
+
+		if (frog.x >= minPoint.x && frog.x <= maxPoint.x
+				&& frog.y <= logHeight
+				&& frog.z >= minPoint.z && frog.z <= maxPoint.z) {
+			attachFrogOnLog(*logs);
+			isCollided = true;
+			break;
+		}
+		logs++;
+		}
+	return isCollided;
+}
+
+static void checkOutBoundary()
+{
+	Vec3f * frog = &sim.player->pos;
+	float posBoundary = sim.level->width / 2;
+	float negBoundary = -sim.level->width / 2;
+
+	if (frog->x < negBoundary) {
+		frog->x = negBoundary;
+	} else if (frog->x > posBoundary) {
+		frog->x = posBoundary;
+	}
+
+	if (frog->z < negBoundary) {
+		frog->z = negBoundary;
+	} else if (frog->z > posBoundary) {
+		frog->z = posBoundary;
+	}
+}
+
+/*
+ * Move the game on by one fixed step of dt seconds, t is the simulation time at the start of the step
+ */
+static void simulate(Controls* controls, float dt, float t)
+{
+	bool enemyCollided = false;
+	bool logCollided = false;
+
+	updatePlayer(sim.player, dt, controls, t);
+	updateLevel(sim.level, dt);
+
+	enemyCollided = checkEnemiesCollision();
+	updateParticles(sim.particles, enemyCollided, sim.player->pos, dt);
+	if (enemyCollided) {
+		sim.lives--;
+		resetGame();
+	}
+
+	logCollided = checkLogsCollision();
+	if (!logCollided) { // when the log that frog is attached on disappears, onLog -> false
+		sim.player->onLog = false;
+		if (!sim.player->jump) {
+			sim.player->pos.y = 0.0; // frog falls into river when the log disappears
+		}
+	}
+	checkInRiver();
+
+	checkCrossRiver();
+	checkOutBoundary();
+}
+
+/*
+ * Copy the world into the back slot and swap it into the middle for the renderer. Whatever was in the middle,
+ * either a snapshot the renderer skipped or the one it has just let go of, becomes the new back slot
+ */
+static void publishSnapshot() {
+	Snapshot* snapshot = &sim.slots[sim.back];
+	snapshot->time = sim.ticker.last - sim.ticker.accumulator;
+	snapshot->step = sim.ticker.step;
+	savePlayerState(sim.player, &snapshot->player);
+	saveLevelState(sim.level, &snapshot->level);
+	saveParticleState(sim.particles, &snapshot->particles);
+	snapshot->score = sim.score;
+	snapshot->lives = sim.lives;
+	snapshot->resets = sim.resets;
+	snapshot->halted = sim.halt;
+	snapshot->batches = sim.batches;
+	snapshot->batchTime = sim.batchTime;
+	sim.publishedHalt = sim.halt;
+
+	sim.back = atomic_exchange(&sim.middle, sim.back | freshSlot) & slotMask;
+}
+
+/*
+ * Apply input events up to the given clock time. A control counts as pressed for the next step even if it was let go
+ * again before the step came around, so a quick tap between ticks isn't lost
+ */
+static void drainInput(double until) {
+	const InputEvent* event;
+	while ((event = peekInput(sim.input)) && event->time <= until) {
+		if (event->type == haltInput) {
+			sim.halt = !sim.halt;
+			printf(sim.halt ? "Stopping time\n" : "Resuming time\n");
+		} else if (event->type == controlInput) {
+			unsigned int bit = 1u << event->control;
+			if (event->down) {
+				sim.held |= bit;
+				sim.pressed |= bit;
+			} else {
+				sim.held &= ~bit;
+			}
+		}
+		popInput(sim.input);
+	}
+}
+
+/*
+ * The controls for the next step: everything held down, and everything pressed since the last step
+ */
+static Controls takeControls() {
+	unsigned int bits = sim.held | sim.pressed;
+	sim.pressed = 0;
+
+	Controls controls = { 0 };
+	controls.up = bits & (1u << upControl);
+	controls.down = bits & (1u << downControl);
+	controls.left = bits & (1u << leftControl);
+	controls.right = bits & (1u << rightControl);
+	controls.turnLeft = bits & (1u << turnLeftControl);
+	controls.turnRight = bits & (1u << turnRightControl);
+	controls.jump = bits & (1u << jumpControl);
+	return controls;
+}
+
+static void sleepFor(double seconds) {
+	if (seconds <= 0.0)
+		return;
+	struct timespec ts = { (time_t) seconds, (long) ((seconds - (time_t) seconds) * 1e9) };
+	nanosleep(&ts, NULL);
+}
+
+static void* runSim(void* arg) {
+	(void) arg;
+
+	Ticker* ticker = &sim.ticker;
+	while (atomic_load(&sim.running)) {
+		double now = getClockTime();
+
+		if (sim.lives == 0)
+			sim.halt = true;
+
+		if (sim.halt) {
+			// time stands still, so don't let it pile up into steps to catch up on when it starts again
+			ticker->last = now;
+			drainInput(now);
+			sim.pressed = 0;
+			if (sim.halt != sim.publishedHalt)
+				publishSnapshot();
+			sleepFor(ticker->step);
+			continue;
+		}
+
+		// input is applied at the step boundary it happened before, so each step sees what was pressed during it
+		int steps = scheduleTicks(ticker, now);
+		double start = getClockTime();
+		double stepEnd = now - ticker->accumulator - (steps - 1) * ticker->step;
+		for (int i = 0; i < steps && sim.lives > 0; ++i) {
+			drainInput(stepEnd);
+			if (sim.halt)
+				break;
+			Controls controls = takeControls();
+			simulate(&controls, ticker->step, ticker->time);
+			ticker->time += ticker->step;
+			stepEnd += ticker->step;
+		}
+		if (steps > 0) {
+			sim.batches++;
+			sim.batchTime = getClockTime() - start;
+			publishSnapshot();
+		}
+
+		// wake up again when the next step is due
+		sleepFor(ticker->step - ticker->accumulator);
+	}
+	return NULL;
+}
+
+/*
+ * Take over the player, level and particles and start stepping them tickRate times a second, with the controls
+ * and halts from input. The first snapshot is published before the thread starts, so there is always one to draw
+ */
+void startSim(Player* player, Level* level, Particles* particles, InputQueue* input, float tickRate) {
+	if (sim.started)
+		return;
+
+	sim.player = player;
+	sim.level = level;
+	sim.particles = particles;
+	sim.input = input;
+	sim.held = 0;
+	sim.pressed = 0;
+	sim.halt = false;
+	sim.score = 0;
+	sim.lives = startLives;
+	sim.resets = 0;
+	sim.batches = 0;
+	sim.batchTime = 0.0;
+	initTicker(&sim.ticker, tickRate, maxCatchUpSteps);
+	sim.ticker.last = getClockTime();
+
+	sim.back = 0;
+	atomic_store(&sim.middle, 1);
+	sim.front = 2;
+	publishSnapshot();
+
+	atomic_store(&sim.running, true);
+	if (pthread_create(&sim.thread, NULL, runSim, NULL) != 0) {
+		printf("Can't start the simulation thread\n");
+		return;
+	}
+	sim.started = true;
+}
+
+/*
+ * Stop the simulation thread and wait for it, after this the player, level and particles belong to the caller again
+ */
+void stopSim() {
+	if (!sim.started)
+		return;
+	atomic_store(&sim.running, false);
+	pthread_join(sim.thread, NULL);
+	sim.started = false;
+}
+
+/*
+ * The latest complete snapshot, which stays put until the next call
+ */
+const Snapshot* acquireSnapshot() {
+	if (atomic_load(&sim.middle) & freshSlot)
+		sim.front = atomic_exchange(&sim.middle, sim.front) & slotMask;
+	return &sim.slots[sim.front];
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "player.h"
+#include "level.h"
+#include "particles.h"
+#include "input.h"
+
+/*
+ * Everything the render thread needs from one moment of the simulation. time is the clock time the newest state
+ * belongs to and step is how long a step is, so a frame drawn at now is (now - time) / step of the way from prev to current.
+ * resets goes up every time the game starts over, and halted says time has stopped so nothing will change until it starts again.
+ * batches counts the batches of steps run so far, and batchTime is how long the latest one took in seconds
+ */
+typedef struct {
+	double time;
+	float step;
+	PlayerState player;
+	LevelState level;
+	ParticleState particles;
+	int score, lives;
+	unsigned int resets;
+	bool halted;
+	unsigned int batches;
+	double batchTime;
+} Snapshot;
+
+/*
+ * The game logic runs on its own thread in fixed steps, and after each batch of steps copies the world into a snapshot.
+ * Snapshots go through a triple buffer: the simulation fills a back slot and swaps it with the middle one, the renderer
+ * swaps its front slot with the middle one if there is something new there. Both swaps are a single atomic exchange,
+ * so neither thread ever waits on the other and the renderer always has the latest complete snapshot.
+ * Once the simulation is started it owns all of the player, level and particle state it steps, the render thread
+ * only reads the parts that never change after init, and everything else through acquireSnapshot.
+ * Controls and halts come in as events on the input queue, which the simulation is the consumer of
+ */
+void startSim(Player* player, Level* level, Particles* particles, InputQueue* input, float tickRate);
+void stopSim();
+
+const Snapshot* acquireSnapshot();
@@ -1,58 +1,74 @@
 #include "skybox.h"
 #include "gl.h"
+#include "meshcache.h"
+#include "texcache.h"
+#include "glstate.h"
+#include "renderqueue.h"
 
-#include <string.h>
-
-static void loadSkyboxTexture(Skybox * skybox) {
-	const unsigned int texture[n_skybox_textures] = 
-					{
-						loadTexture("res/skybox/negz.jpg"), //negZ
-						loadTexture("res/skybox/posz.jpg"), //posZ
-						loadTexture("res/skybox/negx.jpg"), //negX
-						loadTexture("res/skybox/posx.jpg"),	//posX
-						loadTexture("res/skybox/posy.jpg"), //posY
-						loadTexture("res/skybox/negy.jpg")	//negY
-					};
-	memcpy(skybox->texture, texture, sizeof(texture));
-}
+#include <stddef.h>
 
 void initSkybox(Skybox * skybox) {
-	skybox->mesh = createCube();
+	skybox->mesh = acquireCube();
 	skybox->material = (Material) { { 0.2, 0.2, 0.2, 0 }, { 0.0, 0.5, 1.0, 0 }, { 1, 1, 1, 0 }, 50 };
-	loadSkyboxTexture(skybox);
+	skybox->texture = acquireCubemap("res/skybox");
 }
 
-void renderSkybox(Skybox * skybox, DrawingFlags* flags) {
+/*
+ * Draw the sky with a single draw call.
+ * The queue draws this after the opaque scene. The depth range pins the sky to the far plane and the depth test
+ * then throws away every sky fragment that is already covered, without writing any depth of its own
+ */
+static void drawSkybox(void* data) {
+	Skybox * skybox = (Skybox*) data;
 	Mesh * mesh = skybox->mesh;
-	glPushAttrib(GL_CURRENT_BIT | GL_ENABLE_BIT);
-	
-	if (flags->textures)
-		glEnable(GL_TEXTURE_2D);
-
-	glDisable(GL_DEPTH_TEST);
-
-	for (int i = 0; i < (int) mesh->numVerts; i++) {
-		if (i % 4 == 0) {
-			glBindTexture(GL_TEXTURE_2D, skybox->texture[i / 4]);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-			glBegin(GL_QUADS);
-		}
-		applyMaterial(&skybox->material);
-		submitColor(BLUE);
-		Vec3f vertex = mesh->verts[i].pos;
-		Vec2f tex = mesh->verts[i].tc;
-		glTexCoord2f(tex.x, tex.y);
-		glVertex3f(vertex.x, vertex.y, vertex.z);
-		if (i % 4 == 3) { glEnd(); }
-	}
-
-	glBindTexture(GL_TEXTURE_2D, 0);
-	
-	glEnable(GL_DEPTH_TEST);
+	glPushMatrix();
+	glLoadMatrixf(skybox->rotation.m);
+	glPushAttrib(GL_CURRENT_BIT | GL_ENABLE_BIT | GL_DEPTH_BUFFER_BIT | GL_VIEWPORT_BIT);
+	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+
+	// the sky is never lit, and a cubemap texture if anything
+	glDisable(GL_LIGHTING);
+	glDisable(GL_TEXTURE_2D);
+	if (skybox->textured)
+		glEnable(GL_TEXTURE_CUBE_MAP);
+
+	glDepthRange(1.0, 1.0);
+	glDepthFunc(GL_LEQUAL);
+	glDepthMask(GL_FALSE);
+
+	bindTexture(GL_TEXTURE_CUBE_MAP, skybox->texture);
+	applyMaterial(&skybox->material);
+	submitColor(BLUE);
+
+	// the cube is centred on the origin, so each vertex position doubles as its cubemap lookup direction
+	glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ibo);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glVertexPointer(3, GL_FLOAT, sizeof(Vertex), (void*) offsetof(Vertex, pos));
+	glTexCoordPointer(3, GL_FLOAT, sizeof(Vertex), (void*) offsetof(Vertex, pos));
+
+	glDrawElements(GL_TRIANGLES, mesh->numIndices, GL_UNSIGNED_INT, 0);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	glPopClientAttrib();
 	glPopAttrib();
+	glPopMatrix();
+}
+
+/*
+ * Submit the sky to the render queue, keeping only the rotation of the view so it stays centred on the camera
+ */
+void renderSkybox(Skybox * skybox, Camera* camera, DrawingFlags* flags) {
+	skybox->rotation = camera->view;
+	skybox->rotation.m[12] = skybox->rotation.m[13] = skybox->rotation.m[14] = 0;
+	skybox->textured = flags->textures;
+	submitCustom(skyLayer, camera->eye, drawSkybox, skybox);
 }
 
 void destroySkybox(Skybox * skybox) {
-	destroyMesh(skybox->mesh);
-}
\ No newline at end of file
+	releaseMesh(skybox->mesh);
+	releaseTexture(skybox->texture);
+}
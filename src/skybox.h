@@ -5,14 +5,18 @@
 #include "material.h"
 #include "camera.h"
 
-enum { SKYNZ, SKYPZ, SKYNX, SKYPX, SKYPY, SKYNY, n_skybox_textures } SkyboxTexture;
-	
+/*
+ * The six faces of the sky live in one cubemap, which is sampled with the direction to each cube vertex.
+ * The rotation and textures flag are captured when the sky is submitted, so the queue can draw it later
+ */
 typedef struct {
 	Mesh* mesh;
 	Material material;
-	unsigned int texture[n_skybox_textures];
+	unsigned int texture;
+	Mat4f rotation;
+	bool textured;
 } Skybox;
 
 void initSkybox(Skybox * skybox);
-void renderSkybox(Skybox * skybox, DrawingFlags* flags);
-void destroySkybox(Skybox * skybox);
\ No newline at end of file
+void renderSkybox(Skybox * skybox, Camera* camera, DrawingFlags* flags);
+void destroySkybox(Skybox * skybox);
@@ -7,20 +7,32 @@
 #include "camera.h"
 #include "skybox.h"
 #include "particles.h"
+#include "text.h"
+#include "input.h"
+#include "timing.h"
 
 /*
- * All of the global state for our main functions is declared here
+ * All of the global state for our main functions is declared here. Once the simulation thread is running it owns
+ * the changing parts of the player, level and particles, the score and lives, so those are read from its snapshots.
+ * resets is the snapshot reset count the camera was last put back for, and batches the simulation batch last timed.
+ * Key events go to the simulation through keys, mouse events to the camera through mouse, and only lmb and rmb of controls are used.
+ * animating is whether the last snapshot drawn was still moving, and sleeping is whether we've stopped drawing because it wasn't
  */
 typedef struct {
 	Player player;
 	Level level;
 	Controls controls;
+	InputQueue keys, mouse;
 	Camera camera;
 	DrawingFlags drawingFlags;
-	int score, lives;
-	bool halt;
-	int frames;
-	float frameRate, frameRateInterval, lastFrameRateT;
+	unsigned int resets, batches;
+	TimingStats timings[n_timings];
+	const char* timingsPath;
+	float frameRateInterval;
+	double lastFrameRateT;
+	double lastInputT;
+	bool animating, sleeping;
 	Skybox skybox;
 	Particles particles;
+	Text osd;
 } Globals;
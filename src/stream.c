@@ -0,0 +1,169 @@
+#include "stream.h"
+#include "gl.h"
+#include "util.h"
+
+#include <string.h>
+
+enum { streamRegions = 3, streamAlignment = 64 };
+
+/*
+ * A buffer and where its contents are written: the persistent mapping of all of its regions, or a CPU copy of one region
+ */
+typedef struct {
+	unsigned int buffer;
+	unsigned char* data;
+	size_t regionSize;
+} StreamStorage;
+
+static struct {
+	bool persistent;
+	StreamStorage storage;
+	GLsync fences[streamRegions];
+	int region;
+	size_t used;
+	StreamStorage* retired;
+	size_t numRetired, maxRetired;
+} stream;
+
+static bool hasBufferStorage() {
+	const char* extensions = (const char*) glGetString(GL_EXTENSIONS);
+	return extensions && strstr(extensions, "GL_ARB_buffer_storage") != NULL;
+}
+
+static StreamStorage createStorage(size_t regionSize) {
+	StreamStorage storage = { 0, NULL, regionSize };
+	glGenBuffers(1, &storage.buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, storage.buffer);
+	if (stream.persistent) {
+		// coherent, so writes show up for the draws after them without flushing
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_ARRAY_BUFFER, regionSize * streamRegions, NULL, flags);
+		storage.data = (unsigned char*) glMapBufferRange(GL_ARRAY_BUFFER, 0, regionSize * streamRegions, flags);
+	} else {
+		glBufferData(GL_ARRAY_BUFFER, regionSize, NULL, GL_STREAM_DRAW);
+		storage.data = (unsigned char*) malloc(regionSize);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	return storage;
+}
+
+static void destroyStorage(StreamStorage* storage) {
+	// deleting a buffer also unmaps it, and GL keeps it around until the draws reading it are done
+	glDeleteBuffers(1, &storage->buffer);
+	if (!stream.persistent)
+		free(storage->data);
+	storage->buffer = 0;
+	storage->data = NULL;
+}
+
+static void clearFences() {
+	for (int i = 0; i < streamRegions; ++i) {
+		if (stream.fences[i])
+			glDeleteSync(stream.fences[i]);
+		stream.fences[i] = NULL;
+	}
+}
+
+/*
+ * Move on to a new buffer of the given region size. Ranges from the old one stay valid until the end of the frame
+ */
+static void replaceStorage(size_t regionSize) {
+	if (stream.numRetired == stream.maxRetired) {
+		stream.maxRetired = max(stream.maxRetired * 2, 4);
+		stream.retired = (StreamStorage*) realloc(stream.retired, stream.maxRetired * sizeof(StreamStorage));
+	}
+	stream.retired[stream.numRetired++] = stream.storage;
+
+	clearFences();
+	stream.storage = createStorage(regionSize);
+	stream.region = 0;
+	stream.used = 0;
+}
+
+static size_t regionOffset() {
+	return stream.persistent ? stream.region * stream.storage.regionSize : 0;
+}
+
+/*
+ * Set up a stream with room for frameSize bytes a frame, it grows if a frame ever needs more
+ */
+void initStream(size_t frameSize) {
+	stream.persistent = hasBufferStorage();
+	stream.storage = createStorage(frameSize);
+	stream.region = 0;
+	stream.used = 0;
+}
+
+void destroyStream() {
+	clearFences();
+	for (size_t i = 0; i < stream.numRetired; ++i)
+		destroyStorage(&stream.retired[i]);
+	free(stream.retired);
+	destroyStorage(&stream.storage);
+	memset(&stream, 0, sizeof(stream));
+}
+
+/*
+ * Move on to the next region. If the GPU still hasn't finished with it, three frames on, we don't wait:
+ * the whole buffer is swapped for a fresh one instead
+ */
+void beginStreamFrame() {
+	stream.used = 0;
+	if (!stream.persistent) {
+		glBindBuffer(GL_ARRAY_BUFFER, stream.storage.buffer);
+		glBufferData(GL_ARRAY_BUFFER, stream.storage.regionSize, NULL, GL_STREAM_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		return;
+	}
+
+	stream.region = (stream.region + 1) % streamRegions;
+	GLsync fence = stream.fences[stream.region];
+	if (!fence)
+		return;
+
+	GLenum status = glClientWaitSync(fence, 0, 0);
+	if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+		glDeleteSync(fence);
+		stream.fences[stream.region] = NULL;
+	} else {
+		replaceStorage(stream.storage.regionSize);
+	}
+}
+
+/*
+ * Fence off this frame's region, and let go of any buffers that were replaced during it
+ */
+void endStreamFrame() {
+	if (stream.persistent)
+		stream.fences[stream.region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	for (size_t i = 0; i < stream.numRetired; ++i)
+		destroyStorage(&stream.retired[i]);
+	stream.numRetired = 0;
+}
+
+/*
+ * Reserve size bytes of this frame's region to write into
+ */
+StreamRange allocStream(size_t size) {
+	size_t offset = (stream.used + streamAlignment - 1) & ~(size_t) (streamAlignment - 1);
+	if (offset + size > stream.storage.regionSize) {
+		replaceStorage(max(stream.storage.regionSize * 2, size * 2));
+		offset = 0;
+	}
+	stream.used = offset + size;
+
+	offset += regionOffset();
+	return (StreamRange) { stream.storage.data + offset, stream.storage.buffer, offset };
+}
+
+/*
+ * Make the first size bytes written to a range visible to the GPU. For a mapped range they already are
+ */
+void commitStream(const StreamRange* range, size_t size) {
+	if (stream.persistent || size == 0)
+		return;
+	glBindBuffer(GL_ARRAY_BUFFER, range->buffer);
+	glBufferSubData(GL_ARRAY_BUFFER, range->offset, size, range->data);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
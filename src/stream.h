@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * One GL buffer for everything that is written fresh each frame: instance transforms, particle positions, OSD quads
+ * and debug lines. It is split into three regions so the CPU can fill one while the GPU is still reading the two before.
+ * With GL_ARB_buffer_storage the buffer stays mapped for good and a fence on each region says when it can be reused,
+ * so ranges are written straight into the GPU's copy and nothing is ever reallocated. Without it, ranges are written
+ * into a CPU copy that commitStream uploads, and the buffer is orphaned once a frame instead.
+ * A range is good until endStreamFrame, and has to be committed before the draw that reads it
+ */
+typedef struct {
+	void* data;
+	unsigned int buffer;
+	size_t offset;
+} StreamRange;
+
+void initStream(size_t frameSize);
+void destroyStream();
+
+void beginStreamFrame();
+void endStreamFrame();
+
+StreamRange allocStream(size_t size);
+void commitStream(const StreamRange* range, size_t size);
@@ -0,0 +1,496 @@
+#include "texcache.h"
+#include "util.h"
+#include "gl.h"
+#include "jobs.h"
+#include "archive.h"
+
+#include <string.h>
+#include <pthread.h>
+#include <SOIL/SOIL.h>
+
+enum { texture2D, textureCube, textureAtlas };
+enum { numCubeFaces = 6 };
+
+// atlases are a 2x2 grid of square cells, with only enough mip levels that a cell never blurs into its neighbours
+enum { atlasGrid = 2, maxAtlasCells = atlasGrid * atlasGrid, atlasCellSize = 1024, atlasLevels = 6 };
+
+typedef struct {
+	char* path;
+	int type;
+	unsigned int id;
+	int refs;
+	bool loading;
+	unsigned int cells[maxAtlasCells];
+	size_t numCells;
+} TextureCacheEntry;
+
+static struct {
+	TextureCacheEntry* entries;
+	size_t numEntries, maxEntries;
+} textureCache;
+
+// SOIL's decoders keep tables and their last error in statics, so only one image is ever decoded at a time.
+// That's the fallback, the default build bakes every image so startup normally reads them straight from res/textures.bin
+static pthread_mutex_t soilLock = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct TextureLoad TextureLoad;
+
+/*
+ * An image being decoded by a worker, and what it ends up as
+ */
+typedef struct {
+	TextureLoad* load;
+	char path[256];
+	const unsigned char* data;
+	size_t size;
+	bool flip;
+	unsigned char* pixels;
+	int width, height, channels;
+} ImageLoad;
+
+struct TextureLoad {
+	unsigned int id;
+	int type;
+	int remaining;
+	ImageLoad images[numCubeFaces];
+};
+
+static TextureCacheEntry* findEntry(unsigned int id) {
+	for (size_t i = 0; i < textureCache.numEntries; ++i)
+		if (textureCache.entries[i].id == id)
+			return &textureCache.entries[i];
+	return NULL;
+}
+
+static GLenum imageFormat(int channels) {
+	switch (channels) {
+		case 1:
+			return GL_LUMINANCE;
+		case 2:
+			return GL_LUMINANCE_ALPHA;
+		case 3:
+			return GL_RGB;
+		default:
+			return GL_RGBA;
+	}
+}
+
+static void cubeFacePath(char* out, size_t size, const char* dir, int face) {
+	static const char* faces[numCubeFaces] = { "posx", "negx", "posy", "negy", "posz", "negz" };
+	snprintf(out, size, "%s/%s.jpg", dir, faces[face]);
+}
+
+static void setTextureParameters(GLenum target, GLenum minFilter) {
+	glTexParameteri(target, GL_TEXTURE_MIN_FILTER, minFilter);
+	glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	if (target == GL_TEXTURE_CUBE_MAP) {
+		// the wrap mode never changes, so set it once here rather than every frame
+		glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	}
+}
+
+/*
+ * Runs on a worker, decoding from the mapped asset. SOIL isn't thread safe, so the decode itself is serialised
+ * and only the row flip runs alongside the other workers
+ */
+static void decodeImage(void* data) {
+	ImageLoad* image = (ImageLoad*) data;
+	if (!image->data)
+		return;
+
+	pthread_mutex_lock(&soilLock);
+	image->pixels = SOIL_load_image_from_memory(image->data, (int) image->size,
+		&image->width, &image->height, &image->channels, SOIL_LOAD_AUTO);
+	pthread_mutex_unlock(&soilLock);
+	if (!image->pixels || !image->flip)
+		return;
+
+	// GL wants the bottom row first
+	size_t stride = (size_t) image->width * image->channels;
+	unsigned char* row = (unsigned char*) malloc(stride);
+	for (int y = 0; y < image->height / 2; ++y) {
+		unsigned char* top = image->pixels + y * stride;
+		unsigned char* bottom = image->pixels + (image->height - 1 - y) * stride;
+		memcpy(row, top, stride);
+		memcpy(top, bottom, stride);
+		memcpy(bottom, row, stride);
+	}
+	free(row);
+}
+
+static void uploadImage(GLenum target, ImageLoad* image) {
+	glTexImage2D(target, 0, image->channels, image->width, image->height, 0,
+		imageFormat(image->channels), GL_UNSIGNED_BYTE, image->pixels);
+}
+
+/*
+ * Draw each cell's texture into the atlas and rebuild its mipmaps. Sources are drawn rather than copied so compressed
+ * textures work too, and an atlas is rebuilt whenever one of its sources finishes loading
+ */
+static void buildAtlas(TextureCacheEntry* atlas) {
+	int size = atlasGrid * atlasCellSize;
+	unsigned int fbo;
+
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, atlas->id, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		printf("Couldn't build the texture atlas, the framebuffer is incomplete\n");
+	}
+
+	glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT | GL_COLOR_BUFFER_BIT | GL_VIEWPORT_BIT | GL_TEXTURE_BIT);
+	glDisable(GL_LIGHTING);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+	glDisable(GL_ALPHA_TEST);
+	glDisable(GL_CULL_FACE);
+	glEnable(GL_TEXTURE_2D);
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+	glViewport(0, 0, size, size);
+
+	glMatrixMode(GL_TEXTURE);
+	glPushMatrix();
+	glLoadIdentity();
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glOrtho(0.0, atlasGrid, 0.0, atlasGrid, -1.0, 1.0);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+
+	glColor4f(1, 1, 1, 1);
+	for (size_t i = 0; i < atlas->numCells; ++i) {
+		float x = i % atlasGrid, y = i / atlasGrid;
+		glBindTexture(GL_TEXTURE_2D, atlas->cells[i]);
+		glBegin(GL_QUADS);
+		glTexCoord2f(0, 0);
+		glVertex2f(x, y);
+		glTexCoord2f(1, 0);
+		glVertex2f(x + 1, y);
+		glTexCoord2f(1, 1);
+		glVertex2f(x + 1, y + 1);
+		glTexCoord2f(0, 1);
+		glVertex2f(x, y + 1);
+		glEnd();
+	}
+
+	glPopMatrix();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_TEXTURE);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &fbo);
+
+	glBindTexture(GL_TEXTURE_2D, atlas->id);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	glPopAttrib();
+}
+
+static void rebuildAtlasesUsing(unsigned int id) {
+	for (size_t i = 0; i < textureCache.numEntries; ++i) {
+		TextureCacheEntry* entry = &textureCache.entries[i];
+		if (entry->type != textureAtlas)
+			continue;
+		for (size_t j = 0; j < entry->numCells; ++j) {
+			if (entry->cells[j] == id) {
+				buildAtlas(entry);
+				break;
+			}
+		}
+	}
+}
+
+/*
+ * Runs on the GL thread once an image is decoded. A cubemap is only uploaded when all of its faces are ready,
+ * so it never has faces of different sizes
+ */
+static void finishTexture(void* data) {
+	TextureLoad* load = ((ImageLoad*) data)->load;
+	if (--load->remaining > 0)
+		return;
+
+	int numImages = load->type == textureCube ? numCubeFaces : 1;
+	bool ok = true;
+	for (int i = 0; i < numImages; ++i) {
+		if (!load->images[i].pixels) {
+			printf("Failed to load texture %s\n", load->images[i].path);
+			ok = false;
+		}
+	}
+
+	TextureCacheEntry* entry = findEntry(load->id);
+	if (entry && ok) {
+		GLenum target = load->type == textureCube ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+
+		glPushAttrib(GL_TEXTURE_BIT);
+		glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glBindTexture(target, load->id);
+		if (load->type == textureCube) {
+			for (int i = 0; i < numCubeFaces; ++i)
+				uploadImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, &load->images[i]);
+		} else {
+			uploadImage(GL_TEXTURE_2D, &load->images[0]);
+		}
+		glGenerateMipmap(target);
+		setTextureParameters(target, GL_LINEAR_MIPMAP_LINEAR);
+		glPopClientAttrib();
+		glPopAttrib();
+	}
+	if (entry)
+		entry->loading = false;
+	if (entry && ok)
+		rebuildAtlasesUsing(load->id);
+
+	for (int i = 0; i < numImages; ++i)
+		SOIL_free_image_data(load->images[i].pixels);
+	free(load);
+}
+
+/*
+ * Upload a texture straight from the baked container if everything it needs was baked with a format we can use
+ */
+static bool loadBakedTexture(unsigned int id, const char* path, int type) {
+	GLenum target = type == textureCube ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+	int numImages = type == textureCube ? numCubeFaces : 1;
+	const BakedTexture* images[numCubeFaces];
+
+	for (int i = 0; i < numImages; ++i) {
+		char facePath[256];
+		if (type == textureCube)
+			cubeFacePath(facePath, sizeof(facePath), path, i);
+		images[i] = findBakedTexture(type == textureCube ? facePath : path);
+		if (!images[i])
+			return false;
+	}
+
+	bool ok = true;
+	glPushAttrib(GL_TEXTURE_BIT);
+	glBindTexture(target, id);
+	for (int i = 0; i < numImages && ok; ++i)
+		ok = uploadBakedTexture(type == textureCube ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + i : GL_TEXTURE_2D, images[i]);
+	if (ok)
+		setTextureParameters(target, GL_LINEAR_MIPMAP_LINEAR);
+	glPopAttrib();
+	return ok;
+}
+
+/*
+ * Make the texture a single white texel on every face until the real image arrives,
+ * then queue up decoding the image files on the workers
+ */
+static void loadTextureAsync(unsigned int id, const char* path, int type) {
+	static const unsigned char white[] = { 255, 255, 255, 255 };
+
+	GLenum target = type == textureCube ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+	int numImages = type == textureCube ? numCubeFaces : 1;
+
+	glPushAttrib(GL_TEXTURE_BIT);
+	glBindTexture(target, id);
+	for (int i = 0; i < numImages; ++i) {
+		GLenum face = type == textureCube ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + i : GL_TEXTURE_2D;
+		glTexImage2D(face, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+	}
+	setTextureParameters(target, GL_LINEAR);
+	glPopAttrib();
+
+	TextureLoad* load = (TextureLoad*) calloc(1, sizeof(TextureLoad));
+	load->id = id;
+	load->type = type;
+	load->remaining = numImages;
+	for (int i = 0; i < numImages; ++i) {
+		ImageLoad* image = &load->images[i];
+		if (type == textureCube)
+			cubeFacePath(image->path, sizeof(image->path), path, i);
+		else
+			snprintf(image->path, sizeof(image->path), "%s", path);
+		image->load = load;
+		image->data = findAsset(image->path, &image->size);
+		image->flip = type == texture2D;
+	}
+
+	// every image's job shares the load, the last one to finish does the upload
+	for (int i = 0; i < numImages; ++i)
+		submitJob(decodeImage, finishTexture, &load->images[i]);
+}
+
+/*
+ * Return the cached texture for a path, loading it first if it isn't in the cache yet
+ */
+static unsigned int acquire(const char* path, int type) {
+	for (size_t i = 0; i < textureCache.numEntries; ++i) {
+		TextureCacheEntry* entry = &textureCache.entries[i];
+		if (entry->type == type && strcmp(entry->path, path) == 0) {
+			entry->refs++;
+			return entry->id;
+		}
+	}
+
+	unsigned int id;
+	glGenTextures(1, &id);
+
+	if (textureCache.numEntries == textureCache.maxEntries) {
+		textureCache.maxEntries = max(textureCache.maxEntries * 2, 16);
+		textureCache.entries = (TextureCacheEntry*) realloc(textureCache.entries, textureCache.maxEntries * sizeof(TextureCacheEntry));
+	}
+	char* copy = (char*) malloc(strlen(path) + 1);
+	strcpy(copy, path);
+	textureCache.entries[textureCache.numEntries++] = (TextureCacheEntry) { copy, type, id, 1, true, { 0 }, 0 };
+
+	// the entry has to exist first, since without workers the decode finishes before loadTextureAsync returns
+	if (loadBakedTexture(id, path, type))
+		findEntry(id)->loading = false;
+	else
+		loadTextureAsync(id, path, type);
+	return id;
+}
+
+unsigned int acquireTexture(const char* path) {
+	return acquire(path, texture2D);
+}
+
+/*
+ * The cubemap's faces are the posx/negx/posy/negy/posz/negz images in the given directory
+ */
+unsigned int acquireCubemap(const char* dir) {
+	return acquire(dir, textureCube);
+}
+
+/*
+ * Pack up to four textures into the cells of one atlas, in order, so things drawn with any of them can share a binding.
+ * Use selectAtlasCell to point texture coordinates at a cell
+ */
+unsigned int acquireAtlas(const char** paths, size_t numPaths) {
+	numPaths = min(numPaths, (size_t) maxAtlasCells);
+
+	char key[1024] = "";
+	for (size_t i = 0; i < numPaths; ++i) {
+		strncat(key, paths[i], sizeof(key) - strlen(key) - 2);
+		strcat(key, "|");
+	}
+
+	for (size_t i = 0; i < textureCache.numEntries; ++i) {
+		TextureCacheEntry* entry = &textureCache.entries[i];
+		if (entry->type == textureAtlas && strcmp(entry->path, key) == 0) {
+			entry->refs++;
+			return entry->id;
+		}
+	}
+
+	TextureCacheEntry atlas = { NULL, textureAtlas, 0, 1, false, { 0 }, numPaths };
+	for (size_t i = 0; i < numPaths; ++i)
+		atlas.cells[i] = acquireTexture(paths[i]);
+
+	int size = atlasGrid * atlasCellSize;
+	glPushAttrib(GL_TEXTURE_BIT);
+	glGenTextures(1, &atlas.id);
+	glBindTexture(GL_TEXTURE_2D, atlas.id);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, size, size, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, atlasLevels - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	setTextureParameters(GL_TEXTURE_2D, GL_LINEAR_MIPMAP_LINEAR);
+	glPopAttrib();
+
+	if (textureCache.numEntries == textureCache.maxEntries) {
+		textureCache.maxEntries = max(textureCache.maxEntries * 2, 16);
+		textureCache.entries = (TextureCacheEntry*) realloc(textureCache.entries, textureCache.maxEntries * sizeof(TextureCacheEntry));
+	}
+	atlas.path = (char*) malloc(strlen(key) + 1);
+	strcpy(atlas.path, key);
+	textureCache.entries[textureCache.numEntries] = atlas;
+	buildAtlas(&textureCache.entries[textureCache.numEntries++]);
+	return atlas.id;
+}
+
+/*
+ * Where [0, 1] texture coordinates land in one cell of an atlas, as an offset (x, y) and a scale (z, w).
+ * It stays half a texel of the smallest mip level inside the cell so filtering never picks up the neighbouring cell.
+ * A cell of -1 is the whole texture
+ */
+Vec4f getAtlasCellRect(int cell) {
+	if (cell < 0)
+		return (Vec4f) { 0, 0, 1, 1 };
+
+	float inset = 0.5f / (atlasCellSize >> (atlasLevels - 1));
+	float scale = (1 - 2 * inset) / atlasGrid;
+	return (Vec4f) { (cell % atlasGrid + inset) / atlasGrid, (cell / atlasGrid + inset) / atlasGrid, scale, scale };
+}
+
+/*
+ * Map texture coordinates into one cell of the bound atlas with the texture matrix
+ */
+void selectAtlasCell(int cell) {
+	Vec4f rect = getAtlasCellRect(cell);
+
+	glMatrixMode(GL_TEXTURE);
+	glLoadIdentity();
+	glTranslatef(rect.x, rect.y, 0);
+	glScalef(rect.z, rect.w, 1);
+	glMatrixMode(GL_MODELVIEW);
+}
+
+void clearAtlasCell() {
+	glMatrixMode(GL_TEXTURE);
+	glLoadIdentity();
+	glMatrixMode(GL_MODELVIEW);
+}
+
+/*
+ * Stop using a texture from the cache. It isn't deleted until the cache is purged
+ */
+void releaseTexture(unsigned int id) {
+	if (!id)
+		return;
+
+	TextureCacheEntry* entry = findEntry(id);
+	if (entry)
+		entry->refs--;
+}
+
+/*
+ * Delete every texture that nobody is using any more
+ */
+void purgeTextureCache() {
+	// an atlas going away lets go of its cells, which can then go in the same purge
+	for (size_t i = 0; i < textureCache.numEntries; ++i) {
+		TextureCacheEntry* entry = &textureCache.entries[i];
+		if (entry->type == textureAtlas && entry->refs <= 0) {
+			for (size_t j = 0; j < entry->numCells; ++j)
+				releaseTexture(entry->cells[j]);
+			entry->numCells = 0;
+		}
+	}
+
+	size_t kept = 0;
+	for (size_t i = 0; i < textureCache.numEntries; ++i) {
+		TextureCacheEntry entry = textureCache.entries[i];
+		// textures still being decoded are kept, so their ids can't be handed out again before the upload
+		if (entry.refs > 0 || entry.loading) {
+			textureCache.entries[kept++] = entry;
+		} else {
+			glDeleteTextures(1, &entry.id);
+			free(entry.path);
+		}
+	}
+	textureCache.numEntries = kept;
+}
+
+/*
+ * Delete every texture in the cache, whether it is still being used or not
+ */
+void destroyTextureCache() {
+	for (size_t i = 0; i < textureCache.numEntries; ++i) {
+		glDeleteTextures(1, &textureCache.entries[i].id);
+		free(textureCache.entries[i].path);
+	}
+	free(textureCache.entries);
+	textureCache.entries = NULL;
+	textureCache.numEntries = textureCache.maxEntries = 0;
+}
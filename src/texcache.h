@@ -0,0 +1,23 @@
+#pragma once
+
+#include "vec.h"
+
+#include <stddef.h>
+
+/*
+ * A cache of the textures loaded from disk, keyed by path, so everything asking for the same image shares one GL texture.
+ * Like the mesh cache, textures count their users and ones nobody is using stay loaded until purgeTextureCache is called,
+ * so a level reset that releases and acquires the same textures doesn't decode or upload anything.
+ * Images are decoded on the job workers; until one arrives its texture is a single white texel
+ */
+unsigned int acquireTexture(const char* path);
+unsigned int acquireCubemap(const char* dir);
+unsigned int acquireAtlas(const char** paths, size_t numPaths);
+void releaseTexture(unsigned int id);
+
+Vec4f getAtlasCellRect(int cell);
+void selectAtlasCell(int cell);
+void clearAtlasCell();
+
+void purgeTextureCache();
+void destroyTextureCache();
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * The layout of a baked texture container, written by tools/texbake.c and mapped straight into memory by the game.
+ * The file is a BakedHeader, then numTextures BakedTexture entries, then the pixel data of every mip level.
+ * Offsets are from the start of the file and aligned to bakedAlignment
+ */
+#define BAKED_MAGIC 0x31584554 // "TEX1"
+
+enum { bakedRGB, bakedRGBA, bakedDXT1, bakedDXT5, n_baked_formats };
+enum { maxBakedLevels = 16, maxBakedName = 64, bakedAlignment = 16 };
+
+typedef struct {
+	uint32_t magic;
+	uint32_t numTextures;
+} BakedHeader;
+
+/*
+ * One image and its whole mip chain, down to 1x1. Level i is max(1, width >> i) by max(1, height >> i).
+ * Images are stored bottom row first, except cubemap faces which GL wants top row first
+ */
+typedef struct {
+	char name[maxBakedName];
+	uint32_t format;
+	uint32_t width, height;
+	uint32_t numLevels;
+	uint32_t offsets[maxBakedLevels];
+	uint32_t sizes[maxBakedLevels];
+} BakedTexture;
@@ -0,0 +1,247 @@
+#include "text.h"
+#include "gl.h"
+#include "stream.h"
+
+#include <string.h>
+#include <stddef.h>
+
+/*
+ * Work out how big the cells of a font need to be and where each glyph goes, starting at row y of the atlas.
+ * Returns the first row below the font
+ */
+static int layoutGlyphs(Glyphs* glyphs, void* glutFont, int lineHeight, int atlasWidth, int y) {
+	glyphs->glutFont = glutFont;
+
+	// leave some room around the glyphs, the bitmaps can hang a little past their advance and below the baseline
+	int maxAdvance = 0;
+	for (int c = firstGlyph; c <= lastGlyph; ++c) {
+		glyphs->advance[c - firstGlyph] = glutBitmapWidth(glutFont, c);
+		maxAdvance = max(maxAdvance, glyphs->advance[c - firstGlyph]);
+	}
+	glyphs->padding = 4;
+	glyphs->baseline = 8;
+	glyphs->cellWidth = maxAdvance + glyphs->padding * 2;
+	glyphs->cellHeight = lineHeight + 12;
+
+	int x = 0;
+	for (int i = 0; i < n_glyphs; ++i) {
+		if (x + glyphs->cellWidth > atlasWidth) {
+			x = 0;
+			y += glyphs->cellHeight;
+		}
+		glyphs->cellX[i] = x;
+		glyphs->cellY[i] = y;
+		x += glyphs->cellWidth;
+	}
+	return y + glyphs->cellHeight;
+}
+
+/*
+ * Draw every glyph of the GLUT fonts into the atlas texture once, using a framebuffer object as the render target
+ */
+static void bakeAtlas(Text* text) {
+	unsigned int fbo;
+
+	glGenTextures(1, &text->texture);
+	glBindTexture(GL_TEXTURE_2D, text->texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, text->atlasWidth, text->atlasHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, text->texture, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		printf("Couldn't bake the font atlas, the framebuffer is incomplete\n");
+	}
+
+	glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT | GL_COLOR_BUFFER_BIT | GL_VIEWPORT_BIT);
+	glDisable(GL_LIGHTING);
+	glDisable(GL_TEXTURE_2D);
+	glDisable(GL_DEPTH_TEST);
+
+	glViewport(0, 0, text->atlasWidth, text->atlasHeight);
+	glClearColor(0, 0, 0, 0);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glOrtho(0.0, text->atlasWidth, 0.0, text->atlasHeight, -1.0, 1.0);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+
+	// glBitmap writes the raster colour wherever a bit is set, so the glyphs come out opaque white on a clear background
+	glColor4f(1, 1, 1, 1);
+	for (int f = 0; f < n_fonts; ++f) {
+		Glyphs* glyphs = &text->fonts[f];
+		for (int i = 0; i < n_glyphs; ++i) {
+			glRasterPos2i(glyphs->cellX[i] + glyphs->padding, glyphs->cellY[i] + glyphs->baseline);
+			glutBitmapCharacter(glyphs->glutFont, i + firstGlyph);
+		}
+	}
+
+	glPopMatrix();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+
+	glPopAttrib();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &fbo);
+}
+
+/*
+ * Build the font atlas, this needs a GL context
+ */
+void initText(Text* text) {
+	memset(text, 0, sizeof(Text));
+
+	text->atlasWidth = 512;
+	int y = layoutGlyphs(&text->fonts[fixedFont], GLUT_BITMAP_9_BY_15, 15, text->atlasWidth, 0);
+	y = layoutGlyphs(&text->fonts[titleFont], GLUT_BITMAP_TIMES_ROMAN_24, 24, text->atlasWidth, y);
+
+	text->atlasHeight = 1;
+	while (text->atlasHeight < y)
+		text->atlasHeight *= 2;
+
+	bakeAtlas(text);
+	text->dirty = true;
+}
+
+void destroyText(Text* text) {
+	free(text->verts);
+	glDeleteTextures(1, &text->texture);
+}
+
+/*
+ * Set the string, font, colour and position (in pixels, from the bottom left of the window) of a line.
+ * Nothing has to be rebuilt if all of these are the same as last time
+ */
+void setTextLine(Text* text, size_t line, int font, Vec3f color, float x, float y, const char* str) {
+	if (line >= maxTextLines) {
+		printf("Text line %zu is past the last one, %d\n", line, maxTextLines - 1);
+		return;
+	}
+
+	TextLine* l = &text->lines[line];
+	if (line >= text->numLines) {
+		text->numLines = line + 1;
+		text->dirty = true;
+	}
+
+	if (l->font == font && l->x == x && l->y == y && memcmp(&l->color, &color, sizeof(Vec3f)) == 0
+			&& strncmp(l->text, str, sizeof(l->text)) == 0) {
+		return;
+	}
+
+	l->font = font;
+	l->color = color;
+	l->x = x;
+	l->y = y;
+	strncpy(l->text, str, sizeof(l->text) - 1);
+	l->text[sizeof(l->text) - 1] = '\0';
+	text->dirty = true;
+}
+
+/*
+ * Turn every line into textured quads, one per character
+ */
+static void buildTextQuads(Text* text) {
+	size_t numChars = 0;
+	for (size_t i = 0; i < text->numLines; ++i)
+		numChars += strlen(text->lines[i].text);
+
+	if (numChars * 4 > text->maxVerts) {
+		text->maxVerts = numChars * 4;
+		text->verts = (TextVertex*) realloc(text->verts, text->maxVerts * sizeof(TextVertex));
+	}
+
+	TextVertex* v = text->verts;
+	for (size_t i = 0; i < text->numLines; ++i) {
+		TextLine* line = &text->lines[i];
+		Glyphs* glyphs = &text->fonts[line->font];
+		float x = line->x;
+
+		for (const char* c = line->text; *c; ++c) {
+			int glyph = clamp(*c, firstGlyph, lastGlyph) - firstGlyph;
+
+			// line the cell up so its baseline lands on the line's position, like glRasterPos would
+			float x0 = x - glyphs->padding;
+			float y0 = line->y - glyphs->baseline;
+			float x1 = x0 + glyphs->cellWidth;
+			float y1 = y0 + glyphs->cellHeight;
+			float u0 = glyphs->cellX[glyph] / (float) text->atlasWidth;
+			float v0 = glyphs->cellY[glyph] / (float) text->atlasHeight;
+			float u1 = (glyphs->cellX[glyph] + glyphs->cellWidth) / (float) text->atlasWidth;
+			float v1 = (glyphs->cellY[glyph] + glyphs->cellHeight) / (float) text->atlasHeight;
+
+			*v++ = (TextVertex) { { x0, y0 }, { u0, v0 }, line->color };
+			*v++ = (TextVertex) { { x1, y0 }, { u1, v0 }, line->color };
+			*v++ = (TextVertex) { { x1, y1 }, { u1, v1 }, line->color };
+			*v++ = (TextVertex) { { x0, y1 }, { u0, v1 }, line->color };
+
+			x += glyphs->advance[glyph];
+		}
+	}
+
+	text->numVerts = numChars * 4;
+	text->dirty = false;
+}
+
+/*
+ * Draw all of the lines over the top of the scene in a window of the given size
+ */
+void renderText(Text* text, int width, int height) {
+	if (text->dirty)
+		buildTextQuads(text);
+
+	if (text->numVerts == 0)
+		return;
+
+	glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT | GL_TEXTURE_BIT | GL_COLOR_BUFFER_BIT);
+	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_LIGHTING);
+	glEnable(GL_TEXTURE_2D);
+	glEnable(GL_ALPHA_TEST);
+	glAlphaFunc(GL_GREATER, 0.5);
+	glBindTexture(GL_TEXTURE_2D, text->texture);
+
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glOrtho(0.0, width, 0.0, height, -1.0, 1.0);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+
+	// the quads are only rebuilt when the text changes, but the stream is new every frame so they're copied in each time
+	size_t size = text->numVerts * sizeof(TextVertex);
+	StreamRange range = allocStream(size);
+	memcpy(range.data, text->verts, size);
+	commitStream(&range, size);
+	glBindBuffer(GL_ARRAY_BUFFER, range.buffer);
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glVertexPointer(2, GL_FLOAT, sizeof(TextVertex), (void*) (range.offset + offsetof(TextVertex, pos)));
+	glTexCoordPointer(2, GL_FLOAT, sizeof(TextVertex), (void*) (range.offset + offsetof(TextVertex, tc)));
+	glColorPointer(3, GL_FLOAT, sizeof(TextVertex), (void*) (range.offset + offsetof(TextVertex, color)));
+
+	glDrawArrays(GL_QUADS, 0, text->numVerts);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glPopMatrix();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+
+	glPopClientAttrib();
+	glPopAttrib();
+}
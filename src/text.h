@@ -0,0 +1,55 @@
+#pragma once
+
+#include "util.h"
+
+enum { fixedFont, titleFont, n_fonts };
+
+enum { firstGlyph = 32, lastGlyph = 126, n_glyphs = lastGlyph - firstGlyph + 1 };
+
+/*
+ * Where each glyph of a GLUT bitmap font ended up in the atlas texture.
+ * Every glyph gets a cell of the same size, the baseline sits at the same height inside each cell
+ */
+typedef struct {
+	void* glutFont;
+	int cellWidth, cellHeight;
+	int baseline, padding;
+	int advance[n_glyphs];
+	int cellX[n_glyphs], cellY[n_glyphs];
+} Glyphs;
+
+typedef struct {
+	Vec2f pos, tc;
+	Vec3f color;
+} TextVertex;
+
+/*
+ * One string on the screen. The quads are only rebuilt when one of these changes
+ */
+typedef struct {
+	char text[32];
+	int font;
+	Vec3f color;
+	float x, y;
+} TextLine;
+
+enum { maxTextLines = 16 };
+
+/*
+ * A set of lines that are drawn together with the font atlas in a single draw call
+ */
+typedef struct {
+	unsigned int texture;
+	int atlasWidth, atlasHeight;
+	Glyphs fonts[n_fonts];
+	TextLine lines[maxTextLines];
+	size_t numLines;
+	TextVertex* verts;
+	size_t numVerts, maxVerts;
+	bool dirty;
+} Text;
+
+void initText(Text* text);
+void destroyText(Text* text);
+void setTextLine(Text* text, size_t line, int font, Vec3f color, float x, float y, const char* str);
+void renderText(Text* text, int width, int height);
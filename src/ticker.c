@@ -0,0 +1,42 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "ticker.h"
+
+#include <math.h>
+#include <time.h>
+
+/*
+ * Seconds on a monotonic clock, with much better than GLUT_ELAPSED_TIME's millisecond resolution
+ */
+double getClockTime() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void initTicker(Ticker* ticker, float rate, int maxSteps) {
+	ticker->step = 1.0 / rate;
+	ticker->maxSteps = maxSteps;
+	ticker->last = -1.0;
+	ticker->accumulator = 0.0;
+	ticker->time = 0.0;
+}
+
+/*
+ * How many steps to run for a batch starting at now. The caller runs them, each one ticker->step long,
+ * and moves time on by a step after each
+ */
+int scheduleTicks(Ticker* ticker, double now) {
+	if (ticker->last < 0.0)
+		ticker->last = now;
+	ticker->accumulator += now - ticker->last;
+	ticker->last = now;
+
+	int steps = (int) (ticker->accumulator / ticker->step);
+	if (steps > ticker->maxSteps) {
+		steps = ticker->maxSteps;
+		ticker->accumulator = fmod(ticker->accumulator, ticker->step) + steps * ticker->step;
+	}
+	ticker->accumulator -= steps * ticker->step;
+	return steps;
+}
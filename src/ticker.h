@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdbool.h>
+
+/*
+ * Runs the simulation in fixed steps of 1 / rate seconds, however often it gets to run.
+ * Each time the time since the last one goes into the accumulator and whole steps are taken out of it. No more than
+ * maxSteps are run at once, and time past that is dropped so one slow batch can't snowball into the next.
+ * time is how far the simulation has got, and last - accumulator is the clock time its newest state belongs to
+ */
+typedef struct {
+	double step;
+	int maxSteps;
+	double last, accumulator;
+	double time;
+} Ticker;
+
+double getClockTime();
+
+void initTicker(Ticker* ticker, float rate, int maxSteps);
+int scheduleTicks(Ticker* ticker, double now);
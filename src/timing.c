@@ -0,0 +1,126 @@
+#include "timing.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+static const char* timingNames[n_timings] = { "update", "render", "present" };
+
+static struct {
+	float samples[timingFrames][n_timings];
+	float current[n_timings];
+	int next, count;
+	double lastPresent;
+} timing;
+
+static void clearCurrent() {
+	for (int i = 0; i < n_timings; ++i)
+		timing.current[i] = -1.0;
+}
+
+void initTiming() {
+	timing.next = 0;
+	timing.count = 0;
+	timing.lastPresent = -1.0;
+	clearCurrent();
+}
+
+/*
+ * Add to this frame's time for one of update or render
+ */
+void recordTiming(int which, double seconds) {
+	timing.current[which] = max(timing.current[which], 0.0f) + seconds * 1000.0;
+}
+
+/*
+ * The buffers were just swapped at now, which ends this frame and starts the next
+ */
+void markPresent(double now) {
+	if (timing.lastPresent >= 0.0)
+		timing.current[presentTiming] = (now - timing.lastPresent) * 1000.0;
+	timing.lastPresent = now;
+
+	memcpy(timing.samples[timing.next], timing.current, sizeof(timing.current));
+	timing.next = (timing.next + 1) % timingFrames;
+	timing.count = min(timing.count + 1, timingFrames);
+	clearCurrent();
+}
+
+/*
+ * Don't count the time up to the next swap, for when we deliberately stopped drawing for a while
+ */
+void skipPresentInterval() {
+	timing.lastPresent = -1.0;
+}
+
+static int compareFloats(const void* a, const void* b) {
+	float x = *(const float*) a, y = *(const float*) b;
+	return (x > y) - (x < y);
+}
+
+/*
+ * Nearest rank percentile of sorted values
+ */
+static float percentile(const float* sorted, int n, float p) {
+	int rank = (int) ceilf(p * n);
+	return sorted[clamp(rank - 1, 0, n - 1)];
+}
+
+/*
+ * Fill in the stats for each timing over the frames in the ring, returning how many frames that was
+ */
+int getTimingStats(TimingStats* stats) {
+	float sorted[timingFrames];
+	for (int i = 0; i < n_timings; ++i) {
+		int n = 0;
+		for (int j = 0; j < timing.count; ++j) {
+			if (timing.samples[j][i] >= 0.0)
+				sorted[n++] = timing.samples[j][i];
+		}
+
+		if (n == 0) {
+			stats[i] = (TimingStats) { 0, 0, 0, 0 };
+			continue;
+		}
+		qsort(sorted, n, sizeof(float), compareFloats);
+		stats[i] = (TimingStats) { percentile(sorted, n, 0.5), percentile(sorted, n, 0.95), percentile(sorted, n, 0.99), sorted[n - 1] };
+	}
+	return timing.count;
+}
+
+/*
+ * Write the stats, then every frame in the ring from oldest to newest, as CSV. Missing samples are left empty
+ */
+bool dumpTimings(const char* path) {
+	FILE* file = fopen(path, "w");
+	if (!file) {
+		printf("Can't write timings to %s\n", path);
+		return false;
+	}
+
+	TimingStats stats[n_timings];
+	getTimingStats(stats);
+	fprintf(file, "timing,p50_ms,p95_ms,p99_ms,max_ms\n");
+	for (int i = 0; i < n_timings; ++i)
+		fprintf(file, "%s,%.3f,%.3f,%.3f,%.3f\n", timingNames[i], stats[i].p50, stats[i].p95, stats[i].p99, stats[i].max);
+
+	fprintf(file, "\nframe,update_ms,render_ms,present_ms\n");
+	int first = timing.count < timingFrames ? 0 : timing.next;
+	for (int j = 0; j < timing.count; ++j) {
+		const float* sample = timing.samples[(first + j) % timingFrames];
+		fprintf(file, "%d", j);
+		for (int i = 0; i < n_timings; ++i) {
+			if (sample[i] >= 0.0)
+				fprintf(file, ",%.3f", sample[i]);
+			else
+				fprintf(file, ",");
+		}
+		fprintf(file, "\n");
+	}
+
+	fclose(file);
+	printf("Wrote the timings of the last %d frames to %s\n", timing.count, path);
+	return true;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdbool.h>
+
+/*
+ * Per frame timings on the monotonic clock: how long the simulation's latest batch of steps and render took on the CPU,
+ * and the time from one buffer swap to the next. The last timingFrames frames are kept in a ring, so the percentiles show hitches an average would smooth over.
+ * A frame with no sample for one of them, like the first frame after we stopped drawing for a while, is left out of its stats
+ */
+enum { updateTiming, renderTiming, presentTiming, n_timings };
+
+enum { timingFrames = 1024 };
+
+/*
+ * All in milliseconds
+ */
+typedef struct {
+	float p50, p95, p99, max;
+} TimingStats;
+
+void initTiming();
+
+void recordTiming(int which, double seconds);
+void markPresent(double now);
+void skipPresentInterval();
+
+int getTimingStats(TimingStats* stats);
+bool dumpTimings(const char* path);
@@ -4,7 +4,10 @@
  */
 #include "util.h"
 #include "gl.h"
-#include <SOIL/SOIL.h>
+
+#include "archive.h"
+
+#include <string.h>
 
 const Vec3f WHITE = { 1.0, 1.0, 1.0 };
 const Vec3f RED = { 1.0, 0.0, 0.0 };
@@ -32,32 +35,96 @@ float getTRand(float min, float max) {
 	return getRand() * (max - min) + min;
 }
 
-// draw a set of coloured axes at the origin
-void drawAxes() {
-	glPushAttrib(GL_CURRENT_BIT);
-	glBegin(GL_LINES);
+// the baked texture container, an asset that stays mapped for as long as the game runs
+static struct {
+	const unsigned char* data;
+	size_t size;
+	const BakedHeader* header;
+	const BakedTexture* textures;
+} baked;
+
+// use a container written by tools/texbake so textures can be uploaded straight from it
+bool openBakedTextures(const char* name) {
+	size_t size;
+	const unsigned char* data = findAsset(name, &size);
+	if (!data)
+		return false;
 
-	glColor3f(1, 0, 0);
-	glVertex3f(0, 0, 0);
-	glVertex3f(1, 0, 0);
+	const BakedHeader* header = (const BakedHeader*) data;
+	if (size < sizeof(BakedHeader) || header->magic != BAKED_MAGIC
+		|| sizeof(BakedHeader) + header->numTextures * sizeof(BakedTexture) > size) {
+		printf("%s isn't a baked texture container\n", name);
+		return false;
+	}
+
+	baked.data = data;
+	baked.size = size;
+	baked.header = header;
+	baked.textures = (const BakedTexture*) (header + 1);
+	return true;
+}
 
-	glColor3f(0, 1, 0);
-	glVertex3f(0, 0, 0);
-	glVertex3f(0, 1, 0);
+void closeBakedTextures() {
+	baked.data = NULL;
+	baked.header = NULL;
+	baked.textures = NULL;
+}
 
-	glColor3f(0, 0, 1);
-	glVertex3f(0, 0, 0);
-	glVertex3f(0, 0, 1);
+const BakedTexture* findBakedTexture(const char* name) {
+	if (!baked.header)
+		return NULL;
 
-	glEnd();
+	for (uint32_t i = 0; i < baked.header->numTextures; ++i)
+		if (strncmp(baked.textures[i].name, name, maxBakedName) == 0)
+			return &baked.textures[i];
+	return NULL;
+}
 
-	glPopAttrib();
+static bool hasS3TC() {
+	static int supported = -1;
+	if (supported < 0) {
+		const char* extensions = (const char*) glGetString(GL_EXTENSIONS);
+		supported = extensions && strstr(extensions, "GL_EXT_texture_compression_s3tc") != NULL;
+	}
+	return supported;
 }
 
-// load a texture from file using the SOIL library
-unsigned int loadTexture(const char* filename) {
-	glPushAttrib(GL_TEXTURE_BIT);
-	unsigned int id = SOIL_load_OGL_texture(filename, SOIL_LOAD_AUTO, SOIL_CREATE_NEW_ID, SOIL_FLAG_MIPMAPS | SOIL_FLAG_INVERT_Y);
-	glPopAttrib();
-	return id;
+// upload every mip level of a baked texture into the bound texture's target, or a cubemap face.
+// compressed textures need S3TC, without it nothing is uploaded and this returns false
+bool uploadBakedTexture(unsigned int target, const BakedTexture* texture) {
+	bool compressed = texture->format == bakedDXT1 || texture->format == bakedDXT5;
+	if (texture->format >= n_baked_formats || texture->numLevels == 0 || texture->numLevels > maxBakedLevels
+		|| (compressed && !hasS3TC()))
+		return false;
+
+	for (uint32_t level = 0; level < texture->numLevels; ++level)
+		if ((size_t) texture->offsets[level] + texture->sizes[level] > baked.size)
+			return false;
+
+	glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (uint32_t level = 0; level < texture->numLevels; ++level) {
+		const unsigned char* pixels = baked.data + texture->offsets[level];
+		int w = max(1, (int) (texture->width >> level));
+		int h = max(1, (int) (texture->height >> level));
+
+		switch (texture->format) {
+			case bakedRGB:
+				glTexImage2D(target, level, GL_RGB, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+				break;
+			case bakedRGBA:
+				glTexImage2D(target, level, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+				break;
+			case bakedDXT1:
+				glCompressedTexImage2D(target, level, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, w, h, 0, texture->sizes[level], pixels);
+				break;
+			case bakedDXT5:
+				glCompressedTexImage2D(target, level, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, w, h, 0, texture->sizes[level], pixels);
+				break;
+			default:
+				break;
+		}
+	}
+	glPopClientAttrib();
+	return true;
 }
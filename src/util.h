@@ -1,6 +1,7 @@
 #pragma once
 
 #include "vec.h"
+#include "texfile.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -43,6 +44,7 @@ float getRand();
 float getNRand();
 float getTRand(float min, float max);
 
-void drawAxes();
-
-unsigned int loadTexture(const char* filename);
+bool openBakedTextures(const char* name);
+void closeBakedTextures();
+const BakedTexture* findBakedTexture(const char* name);
+bool uploadBakedTexture(unsigned int target, const BakedTexture* texture);
@@ -111,3 +111,10 @@ Vec3f crossVec3f(Vec3f a, Vec3f b) {
 	v.z = a.x * b.y - a.y * b.x;
 	return v;
 }
+
+Vec3f lerpVec3f(Vec3f a, Vec3f b, float t) {
+	a.x += (b.x - a.x) * t;
+	a.y += (b.y - a.y) * t;
+	a.z += (b.z - a.z) * t;
+	return a;
+}
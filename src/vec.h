@@ -33,3 +33,4 @@ float dotVec3f(Vec3f a, Vec3f b);
 float magVec3f(Vec3f v);
 Vec3f normaliseVec3f(Vec3f v);
 Vec3f crossVec3f(Vec3f a, Vec3f b);
+Vec3f lerpVec3f(Vec3f a, Vec3f b, float t);
@@ -0,0 +1,57 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "files.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+void findFiles(FileList* list, const char* dir, FileFilter filter) {
+	DIR* d = opendir(dir);
+	if (!d) {
+		fprintf(stderr, "Can't open %s\n", dir);
+		return;
+	}
+
+	struct dirent* ent;
+	while ((ent = readdir(d))) {
+		if (ent->d_name[0] == '.')
+			continue;
+
+		char path[1024];
+		snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+		struct stat st;
+		if (stat(path, &st) != 0)
+			continue;
+
+		if (S_ISDIR(st.st_mode)) {
+			findFiles(list, path, filter);
+		} else if (!filter || filter(path)) {
+			if (list->numPaths == list->maxPaths) {
+				list->maxPaths = list->maxPaths ? list->maxPaths * 2 : 16;
+				list->paths = (char**) realloc(list->paths, list->maxPaths * sizeof(char*));
+			}
+			list->paths[list->numPaths] = (char*) malloc(strlen(path) + 1);
+			strcpy(list->paths[list->numPaths++], path);
+		}
+	}
+	closedir(d);
+}
+
+static int comparePaths(const void* a, const void* b) {
+	return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+void sortFiles(FileList* list) {
+	if (list->numPaths)
+		qsort(list->paths, list->numPaths, sizeof(char*), comparePaths);
+}
+
+void freeFiles(FileList* list) {
+	for (size_t i = 0; i < list->numPaths; ++i)
+		free(list->paths[i]);
+	free(list->paths);
+	*list = (FileList) { NULL, 0, 0 };
+}
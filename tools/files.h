@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * Every file under a directory that passes a filter, as paths starting with the directory, sorted by name
+ */
+typedef struct {
+	char** paths;
+	size_t numPaths, maxPaths;
+} FileList;
+
+typedef bool (*FileFilter)(const char* path);
+
+void findFiles(FileList* list, const char* dir, FileFilter filter);
+void sortFiles(FileList* list);
+void freeFiles(FileList* list);
@@ -0,0 +1,94 @@
+/*
+ * respack
+ * Packs every file under a directory into one archive (see src/pakfile.h) that the game maps at startup,
+ * so the game ships as the executable and res.pak and reads its assets with one sequential read.
+ *
+ * usage: respack <dir> <output>
+ */
+#include "pakfile.h"
+#include "files.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t align(uint32_t offset) {
+	return (offset + pakAlignment - 1) / pakAlignment * pakAlignment;
+}
+
+static unsigned char* readFile(const char* path, size_t* size) {
+	FILE* f = fopen(path, "rb");
+	if (!f)
+		return NULL;
+
+	fseek(f, 0, SEEK_END);
+	long length = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	unsigned char* data = (unsigned char*) malloc(length > 0 ? length : 1);
+	*size = fread(data, 1, length, f);
+	fclose(f);
+	return data;
+}
+
+int main(int argc, char** argv) {
+	if (argc != 3) {
+		fprintf(stderr, "usage: %s <dir> <output>\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	const char* dir = argv[1];
+	const char* output = argv[2];
+
+	FileList files = { NULL, 0, 0 };
+	findFiles(&files, dir, NULL);
+	sortFiles(&files);
+
+	PakEntry* entries = (PakEntry*) calloc(files.numPaths ? files.numPaths : 1, sizeof(PakEntry));
+	unsigned char** contents = (unsigned char**) calloc(files.numPaths ? files.numPaths : 1, sizeof(unsigned char*));
+	size_t numEntries = 0;
+
+	uint32_t offset = align(sizeof(PakHeader) + files.numPaths * sizeof(PakEntry));
+	for (size_t i = 0; i < files.numPaths; ++i) {
+		const char* path = files.paths[i];
+		if (strlen(path) >= maxPakName) {
+			fprintf(stderr, "Name too long: %s\n", path);
+			continue;
+		}
+
+		size_t size;
+		unsigned char* data = readFile(path, &size);
+		if (!data) {
+			fprintf(stderr, "Can't read %s\n", path);
+			continue;
+		}
+
+		PakEntry* entry = &entries[numEntries];
+		strcpy(entry->name, path);
+		entry->offset = offset;
+		entry->size = (uint32_t) size;
+		contents[numEntries++] = data;
+		offset = align(offset + entry->size);
+	}
+
+	// the table is sized for every file found, anything skipped just leaves padding before the first file
+	FILE* f = fopen(output, "wb");
+	if (!f) {
+		fprintf(stderr, "Can't write %s\n", output);
+		return EXIT_FAILURE;
+	}
+
+	PakHeader header = { PAK_MAGIC, (uint32_t) numEntries };
+	fwrite(&header, sizeof(header), 1, f);
+	fwrite(entries, sizeof(PakEntry), numEntries, f);
+	for (size_t i = 0; i < numEntries; ++i) {
+		fseek(f, entries[i].offset, SEEK_SET);
+		fwrite(contents[i], 1, entries[i].size, f);
+		free(contents[i]);
+	}
+	fclose(f);
+
+	printf("Packed %zu files into %s, %u bytes\n", numEntries, output, offset);
+	free(entries);
+	free(contents);
+	freeFiles(&files);
+	return EXIT_SUCCESS;
+}
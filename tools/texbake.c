@@ -0,0 +1,201 @@
+/*
+ * texbake
+ * Bakes every image under a directory into one texture container (see src/texfile.h) with its whole mip chain,
+ * so the game can upload textures straight out of a mapped file instead of decoding them at startup.
+ *
+ * usage: texbake [-c] <dir> <output>
+ *   -c  compress with S3TC, DXT1 for opaque images and DXT5 for ones with alpha
+ */
+#include "texfile.h"
+#include "files.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <SOIL/SOIL.h>
+
+// SOIL's DXT encoder is in the library but its header isn't installed
+unsigned char* convert_image_to_DXT1(const unsigned char* const uncompressed, int width, int height, int channels, int* out_size);
+unsigned char* convert_image_to_DXT5(const unsigned char* const uncompressed, int width, int height, int channels, int* out_size);
+
+typedef struct {
+	BakedTexture info;
+	unsigned char* levels[maxBakedLevels];
+} Image;
+
+static bool hasImageExtension(const char* path) {
+	const char* ext = strrchr(path, '.');
+	return ext && (strcmp(ext, ".png") == 0 || strcmp(ext, ".jpg") == 0 || strcmp(ext, ".jpeg") == 0
+		|| strcmp(ext, ".bmp") == 0 || strcmp(ext, ".tga") == 0);
+}
+
+/*
+ * Cubemap faces follow the naming the game loads them by, and aren't flipped
+ */
+static bool isCubeFace(const char* path) {
+	static const char* faces[] = { "posx", "negx", "posy", "negy", "posz", "negz" };
+	const char* base = strrchr(path, '/');
+	base = base ? base + 1 : path;
+	for (int i = 0; i < 6; ++i)
+		if (strncmp(base, faces[i], 4) == 0 && base[4] == '.')
+			return true;
+	return false;
+}
+
+/*
+ * Halve an image with a box filter, clamping at the edges so odd sizes work
+ */
+static unsigned char* halveImage(const unsigned char* src, int w, int h, int channels) {
+	int nw = w > 1 ? w / 2 : 1, nh = h > 1 ? h / 2 : 1;
+	unsigned char* dst = (unsigned char*) malloc((size_t) nw * nh * channels);
+
+	for (int y = 0; y < nh; ++y) {
+		int y0 = y * 2, y1 = y0 + 1 < h ? y0 + 1 : y0;
+		for (int x = 0; x < nw; ++x) {
+			int x0 = x * 2, x1 = x0 + 1 < w ? x0 + 1 : x0;
+			for (int c = 0; c < channels; ++c) {
+				int sum = src[(y0 * w + x0) * channels + c] + src[(y0 * w + x1) * channels + c]
+					+ src[(y1 * w + x0) * channels + c] + src[(y1 * w + x1) * channels + c];
+				dst[(y * nw + x) * channels + c] = (unsigned char) ((sum + 2) / 4);
+			}
+		}
+	}
+	return dst;
+}
+
+static bool bakeImage(Image* image, const char* path, bool compress) {
+	int w, h, c;
+	unsigned char* rgba = SOIL_load_image(path, &w, &h, &c, SOIL_LOAD_RGBA);
+	if (!rgba) {
+		fprintf(stderr, "Can't load %s: %s\n", path, SOIL_last_result());
+		return false;
+	}
+	if (strlen(path) >= maxBakedName) {
+		fprintf(stderr, "Name too long: %s\n", path);
+		SOIL_free_image_data(rgba);
+		return false;
+	}
+
+	// drop the alpha channel if nothing uses it
+	bool opaque = true;
+	for (int i = 0; i < w * h && opaque; ++i)
+		opaque = rgba[i * 4 + 3] == 255;
+
+	int channels = opaque ? 3 : 4;
+	size_t stride = (size_t) w * channels;
+	unsigned char* pixels = (unsigned char*) malloc(stride * h);
+	bool flip = !isCubeFace(path);
+	for (int y = 0; y < h; ++y) {
+		const unsigned char* src = rgba + (size_t) (flip ? h - 1 - y : y) * w * 4;
+		unsigned char* dst = pixels + y * stride;
+		for (int x = 0; x < w; ++x)
+			memcpy(dst + x * channels, src + x * 4, channels);
+	}
+	SOIL_free_image_data(rgba);
+
+	BakedTexture* info = &image->info;
+	memset(info, 0, sizeof(*info));
+	strcpy(info->name, path);
+	info->width = w;
+	info->height = h;
+	if (compress)
+		info->format = opaque ? bakedDXT1 : bakedDXT5;
+	else
+		info->format = opaque ? bakedRGB : bakedRGBA;
+
+	int lw = w, lh = h;
+	for (int level = 0; level < maxBakedLevels; ++level) {
+		if (compress) {
+			int size;
+			image->levels[level] = opaque
+				? convert_image_to_DXT1(pixels, lw, lh, channels, &size)
+				: convert_image_to_DXT5(pixels, lw, lh, channels, &size);
+			info->sizes[level] = size;
+		} else {
+			image->levels[level] = pixels;
+			info->sizes[level] = (uint32_t) lw * lh * channels;
+		}
+		info->numLevels++;
+
+		if (lw == 1 && lh == 1)
+			break;
+
+		unsigned char* next = halveImage(pixels, lw, lh, channels);
+		if (compress)
+			free(pixels);
+		pixels = next;
+		lw = lw > 1 ? lw / 2 : 1;
+		lh = lh > 1 ? lh / 2 : 1;
+	}
+	if (compress)
+		free(pixels);
+
+	return true;
+}
+
+static uint32_t align(uint32_t offset) {
+	return (offset + bakedAlignment - 1) / bakedAlignment * bakedAlignment;
+}
+
+int main(int argc, char** argv) {
+	bool compress = false;
+	int arg = 1;
+	if (arg < argc && strcmp(argv[arg], "-c") == 0) {
+		compress = true;
+		arg++;
+	}
+	if (argc - arg != 2) {
+		fprintf(stderr, "usage: %s [-c] <dir> <output>\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	const char* dir = argv[arg];
+	const char* output = argv[arg + 1];
+
+	FileList found = { NULL, 0, 0 };
+	findFiles(&found, dir, hasImageExtension);
+	sortFiles(&found);
+
+	Image* images = (Image*) calloc(found.numPaths ? found.numPaths : 1, sizeof(Image));
+	size_t numImages = 0;
+	for (size_t i = 0; i < found.numPaths; ++i) {
+		if (bakeImage(&images[numImages], found.paths[i], compress)) {
+			printf("%s %ux%u, %u levels\n", found.paths[i], images[numImages].info.width,
+				images[numImages].info.height, images[numImages].info.numLevels);
+			numImages++;
+		}
+	}
+
+	// lay the levels out after the table of contents
+	uint32_t offset = align(sizeof(BakedHeader) + numImages * sizeof(BakedTexture));
+	for (size_t i = 0; i < numImages; ++i) {
+		for (uint32_t level = 0; level < images[i].info.numLevels; ++level) {
+			images[i].info.offsets[level] = offset;
+			offset = align(offset + images[i].info.sizes[level]);
+		}
+	}
+
+	FILE* f = fopen(output, "wb");
+	if (!f) {
+		fprintf(stderr, "Can't write %s\n", output);
+		return EXIT_FAILURE;
+	}
+
+	BakedHeader header = { BAKED_MAGIC, (uint32_t) numImages };
+	fwrite(&header, sizeof(header), 1, f);
+	for (size_t i = 0; i < numImages; ++i)
+		fwrite(&images[i].info, sizeof(BakedTexture), 1, f);
+
+	for (size_t i = 0; i < numImages; ++i) {
+		for (uint32_t level = 0; level < images[i].info.numLevels; ++level) {
+			fseek(f, images[i].info.offsets[level], SEEK_SET);
+			fwrite(images[i].levels[level], images[i].info.sizes[level], 1, f);
+			free(images[i].levels[level]);
+		}
+	}
+	fclose(f);
+	freeFiles(&found);
+
+	printf("Baked %zu textures into %s\n", numImages, output);
+	return EXIT_SUCCESS;
+}